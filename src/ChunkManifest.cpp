@@ -0,0 +1,115 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ChunkManifest.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ChunkManifest.h"
+
+const size_t ChunkManifest::ENCODED_SIZE = 20;
+const string ChunkManifest::CHUNK_PREFIX = "_zoo_chunk_";
+
+static const char MAGIC[] = { 'Z', 'F', 'M', 1 };
+
+static void putUint(string &out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+static uint64_t getUint(const char *in, int bytes) {
+    const unsigned char *data = reinterpret_cast<const unsigned char*>(in);
+    uint64_t retval = 0;
+    for (int i = 0; i < bytes; i++) {
+        retval = (retval << 8) | data[i];
+    }
+    return retval;
+}
+
+ChunkManifest::ChunkManifest() :
+length_(0), chunkSize_(0), generation_(0) {
+
+}
+
+ChunkManifest::ChunkManifest(uint64_t length, uint32_t chunkSize, uint32_t generation) :
+length_(length), chunkSize_(chunkSize), generation_(generation) {
+
+}
+
+uint64_t ChunkManifest::getLength() const {
+    return length_;
+}
+
+void ChunkManifest::setLength(uint64_t length) {
+    length_ = length;
+}
+
+uint32_t ChunkManifest::getChunkSize() const {
+    return chunkSize_;
+}
+
+uint32_t ChunkManifest::getChunkCount() const {
+    if (chunkSize_ == 0) {
+        return 0;
+    }
+    return (length_ + chunkSize_ - 1) / chunkSize_;
+}
+
+uint32_t ChunkManifest::getGeneration() const {
+    return generation_;
+}
+
+size_t ChunkManifest::getChunkLength(uint32_t index) const {
+    uint64_t start = static_cast<uint64_t>(index) * chunkSize_;
+    if (start >= length_) {
+        return 0;
+    }
+    uint64_t remaining = length_ - start;
+    return remaining < chunkSize_ ? remaining : chunkSize_;
+}
+
+string ChunkManifest::getChunkName(uint32_t index) const {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%u_%06u", CHUNK_PREFIX.c_str(), generation_, index);
+    return name;
+}
+
+string ChunkManifest::encode() const {
+    string retval(MAGIC, sizeof(MAGIC));
+    putUint(retval, length_, 8);
+    putUint(retval, chunkSize_, 4);
+    putUint(retval, generation_, 4);
+    return retval;
+}
+
+bool ChunkManifest::decode(const char *data, size_t length, ChunkManifest &manifest) {
+    if (length != ENCODED_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    manifest.length_ = getUint(data + 4, 8);
+    manifest.chunkSize_ = getUint(data + 12, 4);
+    manifest.generation_ = getUint(data + 16, 4);
+    return manifest.chunkSize_ > 0;
+}
+
+bool ChunkManifest::isChunkName(const string &name) {
+    return name.compare(0, CHUNK_PREFIX.length(), CHUNK_PREFIX) == 0;
+}
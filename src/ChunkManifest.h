@@ -0,0 +1,68 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ChunkManifest.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 11:05 AM
+ */
+
+#ifndef CHUNKMANIFEST_H
+#define CHUNKMANIFEST_H
+
+#include <stdint.h>
+#include <string>
+
+using namespace std;
+
+/*
+ * Describes a file whose contents are too large for a single znode.
+ *
+ * The node itself only holds the manifest, the contents are split into fixed size chunks stored as
+ * children named _zoo_chunk_<generation>_<index>. Every full rewrite bumps the generation so readers
+ * following an older manifest never see a mix of old and new chunks. Writes to a range rewrite the chunks
+ * they cover in place within the current generation, so a read racing one of them may see both.
+ */
+class ChunkManifest {
+public:
+    static const size_t ENCODED_SIZE;
+    static const string CHUNK_PREFIX;
+
+    ChunkManifest();
+    ChunkManifest(uint64_t length, uint32_t chunkSize, uint32_t generation);
+
+    uint64_t getLength() const;
+    void setLength(uint64_t length);
+
+    uint32_t getChunkSize() const;
+    uint32_t getChunkCount() const;
+    uint32_t getGeneration() const;
+
+    // Length of the chunk at index, only the last chunk can be shorter than the chunk size
+    size_t getChunkLength(uint32_t index) const;
+    string getChunkName(uint32_t index) const;
+
+    string encode() const;
+
+    static bool decode(const char *data, size_t length, ChunkManifest &manifest);
+    static bool isChunkName(const string &name);
+
+private:
+    uint64_t length_;
+    uint32_t chunkSize_;
+    uint32_t generation_;
+};
+
+#endif /* CHUNKMANIFEST_H */
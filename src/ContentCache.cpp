@@ -0,0 +1,117 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ContentCache.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 2:30 PM
+ */
+
+#include "ContentCache.h"
+
+ContentCache::ContentCache(size_t budget) :
+store_(budget), hits_(0), misses_(0) {
+
+}
+
+ContentCache::~ContentCache() {
+
+}
+
+void ContentCache::watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx) {
+    ContentCache* cache = reinterpret_cast<ContentCache*>(watcherCtx);
+    if (type == ZOO_SESSION_EVENT) {
+        if (state == ZOO_EXPIRED_SESSION_STATE) {
+            cache->clear();
+        }
+        return;
+    }
+    // Nodes can only be deleted once their children are gone, anything cached below is stale too
+    if (type == ZOO_DELETED_EVENT) {
+        cache->invalidateSubtree(path);
+    } else {
+        cache->invalidate(path);
+    }
+}
+
+bool ContentCache::get(const string &path, string &content) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    if (!store_.get(path, content)) {
+        misses_++;
+        return false;
+    }
+    hits_++;
+    return true;
+}
+
+bool ContentCache::getLength(const string &path, size_t &length) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return store_.getLength(path, length);
+}
+
+bool ContentCache::contains(const string &path) const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return store_.contains(path);
+}
+
+void ContentCache::put(const string &path, const string &content, bool prefetched) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    store_.put(path, content, prefetched);
+}
+
+void ContentCache::invalidate(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    store_.invalidate(path);
+}
+
+void ContentCache::invalidateSubtree(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    store_.invalidateSubtree(path);
+}
+
+void ContentCache::clear() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    store_.clear();
+}
+
+size_t ContentCache::getBudget() const {
+    return store_.getBudget();
+}
+
+size_t ContentCache::getUnreadPrefetchedBytes() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return store_.getUnreadBytes();
+}
+
+size_t ContentCache::getNodeCount() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return store_.getNodeCount();
+}
+
+size_t ContentCache::getMemoryUsage() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return store_.getMemoryUsage();
+}
+
+uint64_t ContentCache::getHits() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return hits_;
+}
+
+uint64_t ContentCache::getMisses() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return misses_;
+}
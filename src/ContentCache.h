@@ -0,0 +1,77 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ContentCache.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 2:30 PM
+ */
+
+#ifndef CONTENTCACHE_H
+#define CONTENTCACHE_H
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <zookeeper/zookeeper.h>
+
+#include "NodeStore.h"
+
+using namespace std;
+
+/*
+ * Byte budgeted cache of decoded node contents.
+ *
+ * Entries are only added together with a watch registered through ContentCache::watcher, so an entry
+ * stays valid until that watch fires. Contents are kept in a NodeStore, cold ones are evicted when over
+ * budget while their length stays known.
+ */
+class ContentCache {
+public:
+    ContentCache(size_t budget);
+    virtual ~ContentCache();
+
+    bool get(const string &path, string &content);
+    bool getLength(const string &path, size_t &length);
+    bool contains(const string &path) const;
+    // prefetched entries count against the prefetch budget until they are first read
+    void put(const string &path, const string &content, bool prefetched);
+    void invalidate(const string &path);
+    void invalidateSubtree(const string &path);
+    void clear();
+
+    size_t getBudget() const;
+    size_t getUnreadPrefetchedBytes() const;
+    size_t getNodeCount() const;
+    size_t getMemoryUsage() const;
+    uint64_t getHits() const;
+    uint64_t getMisses() const;
+
+    // Watcher to register with the reads that fill the cache, its context must be the cache
+    static void watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx);
+
+private:
+    ContentCache(const ContentCache& orig);
+    ContentCache& operator=(const ContentCache &rhs);
+
+    mutable boost::mutex mutex_;
+    NodeStore store_;
+    uint64_t hits_;
+    uint64_t misses_;
+};
+
+#endif /* CONTENTCACHE_H */
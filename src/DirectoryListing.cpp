@@ -0,0 +1,131 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   DirectoryListing.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 11:40 PM
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include "ChunkManifest.h"
+#include "DirectoryListing.h"
+
+static bool compareNames(const char *lhs, const char *rhs) {
+    return strcmp(lhs, rhs) < 0;
+}
+
+DirectoryListing::DirectoryListing(const string &dataNodeName) :
+dataNodeName_(dataNodeName), listed_(false), served_(false) {
+
+}
+
+DirectoryListing::~DirectoryListing() {
+}
+
+bool DirectoryListing::needsListing(off_t offset) const {
+    // Offset 0 after entries were served is a rewinddir, which has to see changes made since opendir
+    return !listed_ || (offset == 0 && served_);
+}
+
+void DirectoryListing::reset(vector<string> &children) {
+    vector<const char*> names;
+    names.reserve(children.size());
+    for (size_t i = 0; i < children.size(); i++) {
+        names.push_back(children[i].c_str());
+    }
+    pack(names);
+    vector<string>().swap(children);
+}
+
+void DirectoryListing::reset(const struct String_vector *children) {
+    vector<const char*> names;
+    if (children != NULL) {
+        names.reserve(children->count);
+        for (int i = 0; i < children->count; i++) {
+            if (!ChunkManifest::isChunkName(children->data[i])) {
+                names.push_back(children->data[i]);
+            }
+        }
+    }
+    pack(names);
+}
+
+void DirectoryListing::pack(vector<const char*> &names) {
+    std::sort(names.begin(), names.end(), compareNames);
+
+    size_t length = 0;
+    for (size_t i = 0; i < names.size(); i++) {
+        length += strlen(names[i]) + 1;
+    }
+    string packed;
+    packed.reserve(length);
+    vector<uint32_t> offsets;
+    offsets.reserve(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        offsets.push_back(packed.length());
+        packed.append(names[i]);
+        packed.push_back('\0');
+    }
+    names_.swap(packed);
+    offsets_.swap(offsets);
+    listed_ = true;
+    served_ = false;
+}
+
+bool DirectoryListing::hasDataNodeChild() const {
+    size_t low = 0;
+    size_t high = offsets_.size();
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int order = strcmp(names_.data() + offsets_[middle], dataNodeName_.c_str());
+        if (order == 0) {
+            return true;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
+
+void DirectoryListing::getChildren(vector<string> &children) const {
+    children.reserve(children.size() + offsets_.size());
+    for (size_t i = 0; i < offsets_.size(); i++) {
+        children.push_back(names_.data() + offsets_[i]);
+    }
+}
+
+size_t DirectoryListing::getEntryCount() const {
+    return FIXED_ENTRIES + offsets_.size();
+}
+
+const char* DirectoryListing::getEntry(size_t index) {
+    served_ = true;
+    switch (index) {
+        case 0:
+            return ".";
+        case 1:
+            return "..";
+        case 2:
+            return dataNodeName_.c_str();
+        default:
+            return names_.data() + offsets_[index - FIXED_ENTRIES];
+    }
+}
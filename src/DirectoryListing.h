@@ -0,0 +1,79 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   DirectoryListing.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 11:40 PM
+ */
+
+#ifndef DIRECTORYLISTING_H
+#define DIRECTORYLISTING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+/*
+ * Snapshot of the children of a node kept by an open directory, so readdir can serve it one page at a time.
+ *
+ * The listing is taken on the first readdir and again when the directory is rewound, any other offset is
+ * served from the snapshot without contacting the zoo. Entry offsets are indexes into the snapshot: ".",
+ * "..", the data node, then the children sorted by name. Names are packed into one buffer, costing a few
+ * bytes per child beyond the names themselves, and locating a page is a single index.
+ */
+class DirectoryListing {
+public:
+    DirectoryListing(const string &dataNodeName);
+    virtual ~DirectoryListing();
+
+    // True when readdir at the offset has to list the node again before serving entries
+    bool needsListing(off_t offset) const;
+
+    // Replace the snapshot, leaving children empty
+    void reset(vector<string> &children);
+    // Replace the snapshot with a zookeeper result, skipping chunk nodes
+    void reset(const struct String_vector *children);
+
+    // True when a child clashes with the data node, which can not be shown
+    bool hasDataNodeChild() const;
+    void getChildren(vector<string> &children) const;
+
+    size_t getEntryCount() const;
+    // Name of the entry at the index, valid until the next reset
+    const char* getEntry(size_t index);
+
+private:
+    DirectoryListing(const DirectoryListing& orig);
+    DirectoryListing& operator=(const DirectoryListing &rhs);
+
+    static const size_t FIXED_ENTRIES = 3;
+
+    void pack(vector<const char*> &names);
+
+    const string dataNodeName_;
+    string names_;
+    vector<uint32_t> offsets_;
+    bool listed_;
+    bool served_;
+};
+
+#endif /* DIRECTORYLISTING_H */
+
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   HedgedReads.cpp
+ * Author: kyle
+ *
+ * Created on October 23, 2026, 10:20 AM
+ */
+
+#include <time.h>
+#include <algorithm>
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "HedgedReads.h"
+
+const size_t HedgedReads::STALE_BUDGET = 64 * 1024 * 1024;
+const uint64_t HedgedReads::WRITE_FENCE = 10 * 1000000;
+
+// Fences are swept for expired entries whenever this many more are kept
+static const size_t FENCE_SWEEP = 4096;
+
+struct HedgedReads::Call {
+    Call() :
+    finished(false), hedgeWon(false) {
+
+    }
+
+    boost::mutex mutex;
+    boost::condition_variable done;
+    bool finished;
+    bool hedgeWon;
+    SingleFlight::Result result;
+};
+
+struct HedgedReads::Request {
+    Request(HedgedReads *owner, const boost::shared_ptr<Call> &call, bool hedge) :
+    owner(owner), call(call), hedge(hedge), start(now()) {
+
+    }
+
+    HedgedReads *owner;
+    boost::shared_ptr<Call> call;
+    bool hedge;
+    uint64_t start;
+};
+
+HedgedReads::HedgedReads(const string &hosts, const string &authScheme, const string &auth, unsigned int deadlineMillis,
+                         bool hedge, bool serveStale) :
+hosts_(hosts),
+authScheme_(authScheme),
+auth_(auth),
+deadline_(static_cast<uint64_t>(deadlineMillis) * 1000),
+hedge_(hedge),
+serveStale_(serveStale),
+hedgeHandle_(NULL),
+hedgeConnected_(false),
+samples_(SAMPLE_COUNT),
+sampleCount_(0),
+p95_(0),
+staleBytes_(0),
+staleSequence_(0),
+hedged_(0),
+hedgeWins_(0),
+timeouts_(0),
+staleServed_(0) {
+
+}
+
+HedgedReads::~HedgedReads() {
+    // Closing completes whatever is still in flight, which needs the rest of this object
+    if (hedgeHandle_ != NULL) {
+        zookeeper_close(hedgeHandle_);
+    }
+}
+
+uint64_t HedgedReads::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+string HedgedReads::makeKey(SingleFlight::Operation operation, const string &path) {
+    string retval;
+    retval.reserve(path.length() + 1);
+    retval.push_back('0' + operation);
+    retval += path;
+    return retval;
+}
+
+void HedgedReads::sessionWatcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx) {
+    HedgedReads* hedgedReads = reinterpret_cast<HedgedReads*>(watcherCtx);
+    if (type == ZOO_SESSION_EVENT) {
+        hedgedReads->hedgeConnected_ = state == ZOO_CONNECTED_STATE;
+    }
+}
+
+zhandle_t* HedgedReads::getHedgeHandle() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    // Opened on first use, the session threads would not survive fuse daemonizing
+    if (hedgeHandle_ == NULL) {
+        hedgeHandle_ = zookeeper_init(hosts_.c_str(), sessionWatcher, 10, NULL, this, 0);
+        if (hedgeHandle_ != NULL && !authScheme_.empty() && !auth_.empty()) {
+            zoo_add_auth(hedgeHandle_, authScheme_.c_str(), auth_.c_str(), auth_.size(), NULL, NULL);
+        }
+    }
+    return hedgeConnected_ ? hedgeHandle_ : NULL;
+}
+
+bool HedgedReads::complete(Request *request, int rc) {
+    // Failures of the hedge session say nothing about the node, leave the answer to the first session
+    if (request->hedge && rc != ZOK && rc != ZNONODE && rc != ZNOAUTH) {
+        return false;
+    }
+    Call &call = *request->call;
+    if (call.finished) {
+        return false;
+    }
+    call.finished = true;
+    call.hedgeWon = request->hedge;
+    call.result.rc = rc;
+    call.done.notify_all();
+    return true;
+}
+
+void HedgedReads::statCompletion(int rc, const struct Stat *stat, const void *data) {
+    Request* request = const_cast<Request*>(reinterpret_cast<const Request*>(data));
+    {
+        boost::lock_guard<boost::mutex> lock(request->call->mutex);
+        if (complete(request, rc) && rc == ZOK) {
+            request->call->result.stat = *stat;
+        }
+    }
+    if (!request->hedge) {
+        request->owner->addSample(now() - request->start);
+    }
+    delete request;
+}
+
+void HedgedReads::dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    Request* request = const_cast<Request*>(reinterpret_cast<const Request*>(data));
+    {
+        boost::lock_guard<boost::mutex> lock(request->call->mutex);
+        if (complete(request, rc) && rc == ZOK) {
+            request->call->result.stat = *stat;
+            if (value != NULL && valueLength > 0) {
+                request->call->result.data.assign(value, valueLength);
+            }
+        }
+    }
+    if (!request->hedge) {
+        request->owner->addSample(now() - request->start);
+    }
+    delete request;
+}
+
+void HedgedReads::childrenCompletion(int rc, const struct String_vector *strings, const void *data) {
+    Request* request = const_cast<Request*>(reinterpret_cast<const Request*>(data));
+    {
+        boost::lock_guard<boost::mutex> lock(request->call->mutex);
+        if (complete(request, rc) && rc == ZOK) {
+            for (int i = 0; i < strings->count; i++) {
+                request->call->result.children.push_back(strings->data[i]);
+            }
+        }
+    }
+    if (!request->hedge) {
+        request->owner->addSample(now() - request->start);
+    }
+    delete request;
+}
+
+int HedgedReads::issue(SingleFlight::Operation operation, zhandle_t *handle, const string &path, watcher_fn watcher,
+                       void *watcherContext, Request *request) {
+    switch (operation) {
+        case SingleFlight::EXISTS:
+            return watcher ? zoo_awexists(handle, path.c_str(), watcher, watcherContext, statCompletion, request)
+                           : zoo_aexists(handle, path.c_str(), 0, statCompletion, request);
+        case SingleFlight::GET:
+            return watcher ? zoo_awget(handle, path.c_str(), watcher, watcherContext, dataCompletion, request)
+                           : zoo_aget(handle, path.c_str(), 0, dataCompletion, request);
+        default:
+            return watcher ? zoo_awget_children(handle, path.c_str(), watcher, watcherContext, childrenCompletion, request)
+                           : zoo_aget_children(handle, path.c_str(), 0, childrenCompletion, request);
+    }
+}
+
+void HedgedReads::run(SingleFlight::Operation operation, zhandle_t *handle, const string &path, watcher_fn watcher,
+                      void *watcherContext, SingleFlight::Result &result) {
+    boost::shared_ptr<Call> call(new Call());
+    Request* primary = new Request(this, call, false);
+    int rc = issue(operation, handle, path, watcher, watcherContext, primary);
+    if (rc != ZOK) {
+        delete primary;
+        result.rc = rc;
+        return;
+    }
+
+    uint64_t start = primary->start;
+    uint64_t deadline = deadline_ > 0 ? start + deadline_ : 0;
+    uint64_t hedgeDelay = hedge_ && !isFenced(path) && getHedgeHandle() != NULL ? getHedgeDelay() : 0;
+    uint64_t hedgeAt = hedgeDelay > 0 ? start + hedgeDelay : 0;
+    bool hedged = false;
+    bool timedOut = false;
+
+    boost::unique_lock<boost::mutex> lock(call->mutex);
+    while (!call->finished) {
+        uint64_t wake = deadline;
+        if (!hedged && hedgeAt != 0 && (wake == 0 || hedgeAt < wake)) {
+            wake = hedgeAt;
+        }
+        if (wake == 0) {
+            call->done.wait(lock);
+            continue;
+        }
+        uint64_t current = now();
+        if (current < wake) {
+            call->done.timed_wait(lock, boost::posix_time::microseconds(wake - current));
+            continue;
+        }
+        if (deadline != 0 && current >= deadline) {
+            // Answers arriving from now on are dropped
+            call->finished = true;
+            timedOut = true;
+            break;
+        }
+
+        hedged = true;
+        lock.unlock();
+        zhandle_t* hedgeHandle = getHedgeHandle();
+        Request* hedge = hedgeHandle != NULL ? new Request(this, call, true) : NULL;
+        if (hedge != NULL && issue(operation, hedgeHandle, path, NULL, NULL, hedge) != ZOK) {
+            delete hedge;
+            hedge = NULL;
+        }
+        if (hedge != NULL) {
+            boost::lock_guard<boost::mutex> statsLock(mutex_);
+            hedged_++;
+        }
+        lock.lock();
+    }
+    bool hedgeWon = call->hedgeWon;
+    if (!timedOut) {
+        result = call->result;
+        // The watch is armed by the primary read, at a state possibly newer than the hedge answered from
+        result.covered = !hedgeWon;
+    }
+    lock.unlock();
+
+    string key = makeKey(operation, path);
+    if (!timedOut) {
+        if (hedgeWon) {
+            boost::lock_guard<boost::mutex> statsLock(mutex_);
+            hedgeWins_++;
+        }
+        if (serveStale_ && result.rc == ZOK) {
+            remember(key, result);
+        }
+        return;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> statsLock(mutex_);
+        timeouts_++;
+    }
+    if (serveStale_ && recall(key, result)) {
+        result.covered = false;
+        return;
+    }
+    result = SingleFlight::Result();
+    result.rc = ZOPERATIONTIMEOUT;
+}
+
+uint64_t HedgedReads::getHedgeDelay() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return sampleCount_ >= MIN_SAMPLES ? std::max<uint64_t>(p95_, 1) : 0;
+}
+
+void HedgedReads::addSample(uint64_t latency) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    samples_[sampleCount_ % SAMPLE_COUNT] = latency;
+    sampleCount_++;
+    // Refreshing the estimate every MIN_SAMPLES reads keeps the sort off the common path
+    if (sampleCount_ % MIN_SAMPLES == 0) {
+        size_t count = sampleCount_ < SAMPLE_COUNT ? sampleCount_ : SAMPLE_COUNT;
+        vector<uint64_t> sorted(samples_.begin(), samples_.begin() + count);
+        vector<uint64_t>::iterator p95 = sorted.begin() + sorted.size() * 95 / 100;
+        std::nth_element(sorted.begin(), p95, sorted.end());
+        p95_ = *p95;
+    }
+}
+
+void HedgedReads::remember(const string &key, const SingleFlight::Result &result) {
+    size_t bytes = sizeof (StaleEntry) + key.length() + result.data.length();
+    for (size_t i = 0; i < result.children.size(); i++) {
+        bytes += sizeof (string) + result.children[i].length();
+    }
+    if (bytes > STALE_BUDGET) {
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    StaleEntry &entry = stale_[key];
+    staleBytes_ -= entry.bytes;
+    entry.result = result;
+    entry.sequence = ++staleSequence_;
+    entry.bytes = bytes;
+    staleBytes_ += bytes;
+    staleOrder_.push_back(make_pair(key, entry.sequence));
+
+    // Oldest answers go first, order entries of replaced answers are skipped
+    while (staleBytes_ > STALE_BUDGET && !staleOrder_.empty()) {
+        StaleMap::iterator it = stale_.find(staleOrder_.front().first);
+        if (it != stale_.end() && it->second.sequence == staleOrder_.front().second) {
+            staleBytes_ -= it->second.bytes;
+            stale_.erase(it);
+        }
+        staleOrder_.pop_front();
+    }
+    if (staleOrder_.size() > 2 * stale_.size() + MIN_SAMPLES) {
+        deque<pair<string, uint64_t> > current;
+        for (size_t i = 0; i < staleOrder_.size(); i++) {
+            StaleMap::iterator it = stale_.find(staleOrder_[i].first);
+            if (it != stale_.end() && it->second.sequence == staleOrder_[i].second) {
+                current.push_back(staleOrder_[i]);
+            }
+        }
+        staleOrder_.swap(current);
+    }
+}
+
+bool HedgedReads::recall(const string &key, SingleFlight::Result &result) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    StaleMap::iterator it = stale_.find(key);
+    if (it == stale_.end()) {
+        return false;
+    }
+    result = it->second.result;
+    staleServed_++;
+    return true;
+}
+
+void HedgedReads::fence(const string &path, uint64_t time) {
+    written_[path] = time;
+    if (written_.size() % FENCE_SWEEP == 0) {
+        for (boost::unordered_map<string, uint64_t>::iterator it = written_.begin(); it != written_.end();) {
+            if (it->second + WRITE_FENCE <= time) {
+                it = written_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+bool HedgedReads::isFenced(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    boost::unordered_map<string, uint64_t>::iterator it = written_.find(path);
+    if (it == written_.end()) {
+        return false;
+    }
+    if (it->second + WRITE_FENCE <= now()) {
+        written_.erase(it);
+        return false;
+    }
+    return true;
+}
+
+void HedgedReads::forget(const string &path) {
+    if (!serveStale_ && !hedge_) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    size_t slash = path.rfind('/');
+    string parent = slash == 0 ? "/" : path.substr(0, slash == string::npos ? 0 : slash);
+    if (hedge_) {
+        // Creations and deletions also change the listing of the parent
+        uint64_t time = now();
+        fence(path, time);
+        if (slash != string::npos) {
+            fence(parent, time);
+        }
+    }
+    if (!serveStale_) {
+        return;
+    }
+    // Order entries of erased answers are skipped when they come up
+    for (int operation = SingleFlight::EXISTS; operation <= SingleFlight::CHILDREN; operation++) {
+        StaleMap::iterator it = stale_.find(makeKey(static_cast<SingleFlight::Operation>(operation), path));
+        if (it != stale_.end()) {
+            staleBytes_ -= it->second.bytes;
+            stale_.erase(it);
+        }
+    }
+    if (slash != string::npos) {
+        StaleMap::iterator it = stale_.find(makeKey(SingleFlight::CHILDREN, parent));
+        if (it != stale_.end()) {
+            staleBytes_ -= it->second.bytes;
+            stale_.erase(it);
+        }
+    }
+}
+
+uint64_t HedgedReads::getHedged() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return hedged_;
+}
+
+uint64_t HedgedReads::getHedgeWins() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return hedgeWins_;
+}
+
+uint64_t HedgedReads::getTimeouts() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return timeouts_;
+}
+
+uint64_t HedgedReads::getStaleServed() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return staleServed_;
+}
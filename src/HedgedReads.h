@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   HedgedReads.h
+ * Author: kyle
+ *
+ * Created on October 23, 2026, 10:20 AM
+ */
+
+#ifndef HEDGEDREADS_H
+#define HEDGEDREADS_H
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <zookeeper/zookeeper.h>
+
+#include "SingleFlight.h"
+
+using namespace std;
+
+/*
+ * Bounds reads of the zoo by a deadline, hedging slow ones on a second session.
+ *
+ * Reads are sent asynchronously and waited for until the deadline, after which they fail with
+ * ZOPERATIONTIMEOUT, or when serving stale answers is enabled, return the last answer seen for the same
+ * read. With hedging enabled a read still unanswered after the p95 of recent read latencies is sent again
+ * on a second session, which usually lands on another server, and whichever answer comes first is used.
+ * Watches are only left by the read on the caller's session. The second session may be served by a server
+ * lagging behind the writes of the first, so nodes written locally within WRITE_FENCE are not hedged.
+ * Answers from the hedge or from the stale store are flagged as not covered by the watch of the read.
+ */
+class HedgedReads {
+public:
+    // Latencies kept to estimate the p95, and how many are needed before hedging starts
+    static const size_t SAMPLE_COUNT = 1024;
+    static const size_t MIN_SAMPLES = 64;
+    // Bytes of last answers kept for serving stale
+    static const size_t STALE_BUDGET;
+    // Microseconds after a local write of a node during which its reads are not hedged
+    static const uint64_t WRITE_FENCE;
+
+    HedgedReads(const string &hosts, const string &authScheme, const string &auth, unsigned int deadlineMillis, bool hedge,
+                bool serveStale);
+    virtual ~HedgedReads();
+
+    void run(SingleFlight::Operation operation, zhandle_t *handle, const string &path, watcher_fn watcher,
+             void *watcherContext, SingleFlight::Result &result);
+
+    // Drops the last answers of the path after a local write and stops hedging it for a while, neither stale
+    // answers nor a lagging hedge server must undo the write
+    void forget(const string &path);
+
+    uint64_t getHedged() const;
+    uint64_t getHedgeWins() const;
+    uint64_t getTimeouts() const;
+    uint64_t getStaleServed() const;
+
+    static uint64_t now();
+
+private:
+    HedgedReads(const HedgedReads& orig);
+    HedgedReads& operator=(const HedgedReads &rhs);
+
+    struct Call;
+    struct Request;
+
+    struct StaleEntry {
+        StaleEntry() :
+        sequence(0), bytes(0) {
+
+        }
+
+        SingleFlight::Result result;
+        uint64_t sequence;
+        size_t bytes;
+    };
+
+    typedef boost::unordered_map<string, StaleEntry> StaleMap;
+
+    static void sessionWatcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx);
+    static void statCompletion(int rc, const struct Stat *stat, const void *data);
+    static void dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data);
+    static void childrenCompletion(int rc, const struct String_vector *strings, const void *data);
+    static bool complete(Request *request, int rc);
+
+    static string makeKey(SingleFlight::Operation operation, const string &path);
+
+    int issue(SingleFlight::Operation operation, zhandle_t *handle, const string &path, watcher_fn watcher,
+              void *watcherContext, Request *request);
+    zhandle_t* getHedgeHandle();
+    uint64_t getHedgeDelay() const;
+    void addSample(uint64_t latency);
+    void remember(const string &key, const SingleFlight::Result &result);
+    bool recall(const string &key, SingleFlight::Result &result);
+    void fence(const string &path, uint64_t time);
+    bool isFenced(const string &path);
+
+    const string hosts_;
+    const string authScheme_;
+    const string auth_;
+    const uint64_t deadline_;
+    const bool hedge_;
+    const bool serveStale_;
+
+    mutable boost::mutex mutex_;
+    zhandle_t *hedgeHandle_;
+    volatile bool hedgeConnected_;
+    vector<uint64_t> samples_;
+    size_t sampleCount_;
+    uint64_t p95_;
+    StaleMap stale_;
+    deque<pair<string, uint64_t> > staleOrder_;
+    size_t staleBytes_;
+    uint64_t staleSequence_;
+    // Time of the last local write by node, for WRITE_FENCE
+    boost::unordered_map<string, uint64_t> written_;
+    uint64_t hedged_;
+    uint64_t hedgeWins_;
+    uint64_t timeouts_;
+    uint64_t staleServed_;
+};
+
+#endif /* HEDGEDREADS_H */
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InFlightLimiter.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 4:10 PM
+ */
+
+#include "InFlightLimiter.h"
+
+InFlightLimiter::InFlightLimiter(size_t limit) :
+limit_(limit > 0 ? limit : 1), inFlight_(0), dispatched_(0), throttled_(0) {
+
+}
+
+InFlightLimiter::~InFlightLimiter() {
+
+}
+
+void InFlightLimiter::acquire() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (inFlight_ >= limit_) {
+        throttled_++;
+        while (inFlight_ >= limit_) {
+            available_.wait(lock);
+        }
+    }
+    inFlight_++;
+    dispatched_++;
+}
+
+void InFlightLimiter::release() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    inFlight_--;
+    available_.notify_one();
+}
+
+size_t InFlightLimiter::getLimit() const {
+    return limit_;
+}
+
+size_t InFlightLimiter::getInFlight() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+uint64_t InFlightLimiter::getDispatched() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return dispatched_;
+}
+
+uint64_t InFlightLimiter::getThrottled() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return throttled_;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InFlightLimiter.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 4:10 PM
+ */
+
+#ifndef INFLIGHTLIMITER_H
+#define INFLIGHTLIMITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+/*
+ * Counting semaphore bounding the number of requests outstanding against the zoo.
+ *
+ * acquire blocks the calling fuse worker while the limit is reached, which stops it from reading further
+ * requests and leaves them queued in the kernel instead of on the ensemble.
+ */
+class InFlightLimiter {
+public:
+    InFlightLimiter(size_t limit);
+    virtual ~InFlightLimiter();
+
+    void acquire();
+    void release();
+
+    size_t getLimit() const;
+    size_t getInFlight() const;
+    uint64_t getDispatched() const;
+    uint64_t getThrottled() const;
+
+private:
+    InFlightLimiter(const InFlightLimiter& orig);
+    InFlightLimiter& operator=(const InFlightLimiter &rhs);
+
+    const size_t limit_;
+    size_t inFlight_;
+    uint64_t dispatched_;
+    uint64_t throttled_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable available_;
+};
+
+#endif /* INFLIGHTLIMITER_H */
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InodeTable.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 1:20 PM
+ */
+
+#include <boost/thread/locks.hpp>
+
+#include "InodeTable.h"
+
+const uint64_t InodeTable::ROOT_INODE = 1;
+
+InodeTable::InodeTable(const string &rootZooPath) :
+next_(ROOT_INODE + 1) {
+    Inode& root = inodes_[ROOT_INODE];
+    root.path = "/";
+    root.zooPath = rootZooPath;
+    // The root is never forgotten
+    root.lookups = 1;
+    paths_[root.path] = ROOT_INODE;
+    zooPaths_.insert(make_pair(root.zooPath, ROOT_INODE));
+}
+
+InodeTable::~InodeTable() {
+
+}
+
+uint64_t InodeTable::lookup(const string &path, const string &zooPath) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    PathMap::iterator existing = paths_.find(path);
+    if (existing != paths_.end()) {
+        inodes_[existing->second].lookups++;
+        return existing->second;
+    }
+
+    uint64_t retval = next_++;
+    Inode& inode = inodes_[retval];
+    inode.path = path;
+    inode.zooPath = zooPath;
+    inode.lookups = 1;
+    paths_[path] = retval;
+    zooPaths_.insert(make_pair(zooPath, retval));
+    return retval;
+}
+
+void InodeTable::forget(uint64_t inode, uint64_t count) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    InodeMap::iterator it = inodes_.find(inode);
+    if (it == inodes_.end() || inode == ROOT_INODE) {
+        return;
+    }
+    if (it->second.lookups > count) {
+        it->second.lookups -= count;
+        return;
+    }
+    erase(it);
+}
+
+void InodeTable::erase(InodeMap::iterator inode) {
+    PathMap::iterator path = paths_.find(inode->second.path);
+    if (path != paths_.end() && path->second == inode->first) {
+        paths_.erase(path);
+    }
+
+    std::pair<ZooPathMap::iterator, ZooPathMap::iterator> range = zooPaths_.equal_range(inode->second.zooPath);
+    for (ZooPathMap::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == inode->first) {
+            zooPaths_.erase(it);
+            break;
+        }
+    }
+    inodes_.erase(inode);
+}
+
+bool InodeTable::getPath(uint64_t inode, string &path, string &zooPath) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+
+    InodeMap::const_iterator it = inodes_.find(inode);
+    if (it == inodes_.end()) {
+        return false;
+    }
+    path = it->second.path;
+    zooPath = it->second.zooPath;
+    return true;
+}
+
+uint64_t InodeTable::find(const string &path) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+
+    PathMap::const_iterator it = paths_.find(path);
+    return it == paths_.end() ? 0 : it->second;
+}
+
+void InodeTable::setAttributes(uint64_t inode, const struct stat &attributes, const Stat &zooStat) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    InodeMap::iterator it = inodes_.find(inode);
+    if (it != inodes_.end()) {
+        it->second.attributes = attributes;
+        it->second.zooStat = zooStat;
+        it->second.attributesValid = true;
+    }
+}
+
+bool InodeTable::getAttributes(uint64_t inode, struct stat &attributes, Stat *zooStat) const {
+    boost::shared_lock<boost::shared_mutex> lock(mutex_);
+
+    InodeMap::const_iterator it = inodes_.find(inode);
+    if (it == inodes_.end() || !it->second.attributesValid) {
+        return false;
+    }
+    attributes = it->second.attributes;
+    if (zooStat != NULL) {
+        *zooStat = it->second.zooStat;
+    }
+    return true;
+}
+
+vector<uint64_t> InodeTable::invalidate(const string &zooPath) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    vector<uint64_t> retval;
+    std::pair<ZooPathMap::iterator, ZooPathMap::iterator> range = zooPaths_.equal_range(zooPath);
+    for (ZooPathMap::iterator it = range.first; it != range.second; ++it) {
+        inodes_[it->second].attributesValid = false;
+        retval.push_back(it->second);
+    }
+    return retval;
+}
+
+void InodeTable::invalidateAll() {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    for (InodeMap::iterator it = inodes_.begin(); it != inodes_.end(); ++it) {
+        it->second.attributesValid = false;
+    }
+}
+
+void InodeTable::unlink(const string &path) {
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+
+    PathMap::iterator it = paths_.find(path);
+    if (it != paths_.end()) {
+        inodes_[it->second].attributesValid = false;
+        paths_.erase(it);
+    }
+}
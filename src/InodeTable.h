@@ -0,0 +1,99 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InodeTable.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 1:20 PM
+ */
+
+#ifndef INODETABLE_H
+#define INODETABLE_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+/*
+ * Maps the node ids handed to the kernel by the low level fuse api to paths in the mount and the zoo.
+ *
+ * Entries are reference counted by kernel lookups and released by forget. The attributes last served for
+ * an inode, together with the Stat of its node, are kept until a watch on its node fires, so repeated getattr
+ * and getxattr calls do not touch the zoo.
+ */
+class InodeTable {
+public:
+    static const uint64_t ROOT_INODE;
+
+    InodeTable(const string &rootZooPath);
+    virtual ~InodeTable();
+
+    // Finds or allocates the inode for a path and takes a lookup reference on it
+    uint64_t lookup(const string &path, const string &zooPath);
+    void forget(uint64_t inode, uint64_t count);
+
+    bool getPath(uint64_t inode, string &path, string &zooPath) const;
+    // Returns 0 if the kernel does not know the path
+    uint64_t find(const string &path) const;
+
+    void setAttributes(uint64_t inode, const struct stat &attributes, const Stat &zooStat);
+    bool getAttributes(uint64_t inode, struct stat &attributes, Stat *zooStat = NULL) const;
+
+    // Drops the cached attributes of every inode backed by the node, returning which ones were affected
+    vector<uint64_t> invalidate(const string &zooPath);
+    void invalidateAll();
+
+    // Detaches a removed path, the inode itself lives on until the kernel forgets it
+    void unlink(const string &path);
+
+private:
+    InodeTable(const InodeTable& orig);
+    InodeTable& operator=(const InodeTable &rhs);
+
+    struct Inode {
+        Inode() :
+        lookups(0), attributesValid(false) {
+
+        }
+
+        string path;
+        string zooPath;
+        uint64_t lookups;
+        bool attributesValid;
+        struct stat attributes;
+        Stat zooStat;
+    };
+
+    typedef boost::unordered_map<uint64_t, Inode> InodeMap;
+    typedef boost::unordered_map<string, uint64_t> PathMap;
+    typedef boost::unordered_multimap<string, uint64_t> ZooPathMap;
+
+    void erase(InodeMap::iterator inode);
+
+    mutable boost::shared_mutex mutex_;
+    InodeMap inodes_;
+    PathMap paths_;
+    ZooPathMap zooPaths_;
+    uint64_t next_;
+};
+
+#endif /* INODETABLE_H */
@@ -0,0 +1,98 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InvalidationNotifier.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 9:10 AM
+ */
+#define FUSE_USE_VERSION 26
+
+#include <fuse_lowlevel.h>
+#include <boost/bind.hpp>
+
+#include "InvalidationNotifier.h"
+
+InvalidationNotifier::InvalidationNotifier() :
+channel_(NULL), stopping_(false) {
+
+}
+
+InvalidationNotifier::~InvalidationNotifier() {
+    stop();
+}
+
+void InvalidationNotifier::start(struct fuse_chan *channel) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    channel_ = channel;
+    stopping_ = false;
+    thread_ = boost::thread(boost::bind(&InvalidationNotifier::run, this));
+}
+
+void InvalidationNotifier::stop() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+        changed_.notify_all();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    channel_ = NULL;
+    queue_.clear();
+}
+
+void InvalidationNotifier::invalidateInode(uint64_t inode) {
+    Invalidation invalidation;
+    invalidation.inode = inode;
+    push(invalidation);
+}
+
+void InvalidationNotifier::invalidateEntry(uint64_t parent, const string &name) {
+    Invalidation invalidation;
+    invalidation.inode = parent;
+    invalidation.name = name;
+    push(invalidation);
+}
+
+void InvalidationNotifier::push(const Invalidation &invalidation) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (channel_ == NULL || stopping_) {
+        return;
+    }
+    queue_.push_back(invalidation);
+    changed_.notify_all();
+}
+
+void InvalidationNotifier::run() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (queue_.empty()) {
+            changed_.wait(lock);
+            continue;
+        }
+        Invalidation invalidation = queue_.front();
+        queue_.pop_front();
+        struct fuse_chan *channel = channel_;
+        lock.unlock();
+        if (invalidation.name.empty()) {
+            fuse_lowlevel_notify_inval_inode(channel, invalidation.inode, 0, 0);
+        } else {
+            fuse_lowlevel_notify_inval_entry(channel, invalidation.inode, invalidation.name.c_str(), invalidation.name.length());
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   InvalidationNotifier.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 9:10 AM
+ */
+
+#ifndef INVALIDATIONNOTIFIER_H
+#define INVALIDATIONNOTIFIER_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+
+struct fuse_chan;
+
+/*
+ * Sends kernel cache invalidations of the low level api from a thread of its own.
+ *
+ * Watches fire on the zookeeper completion thread, which with --asyncDispatch is also the only thread
+ * replying to pending reads. An inode invalidation can wait on a page locked by one of those reads, so it
+ * must never be sent from there. Invalidations queued before start or after stop are dropped.
+ */
+class InvalidationNotifier {
+public:
+    InvalidationNotifier();
+    virtual ~InvalidationNotifier();
+
+    // Starts sending to the channel, after daemonizing so the thread belongs to the serving process
+    void start(struct fuse_chan *channel);
+    // Drops what is still queued, the channel is not touched once it returns
+    void stop();
+
+    void invalidateInode(uint64_t inode);
+    void invalidateEntry(uint64_t parent, const string &name);
+
+private:
+    InvalidationNotifier(const InvalidationNotifier& orig);
+    InvalidationNotifier& operator=(const InvalidationNotifier &rhs);
+
+    struct Invalidation {
+        uint64_t inode;
+        // Set for entries, which inode is the parent of
+        string name;
+    };
+
+    void push(const Invalidation &invalidation);
+    void run();
+
+    boost::mutex mutex_;
+    boost::condition_variable changed_;
+    deque<Invalidation> queue_;
+    struct fuse_chan *channel_;
+    bool stopping_;
+    boost::thread thread_;
+};
+
+#endif /* INVALIDATIONNOTIFIER_H */
+
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   MountDaemon.cpp
+ * Author: kyle
+ *
+ * Created on October 26, 2026, 4:20 PM
+ */
+#define FUSE_USE_VERSION 26
+
+#include <fuse.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include "MountDaemon.h"
+
+MountConfig::MountConfig() :
+zooPath("/"), leafMode(LEAF_AS_DIR), maxFileSize(1024) {
+
+}
+
+string MountConfig::getEnsembleKey() const {
+    return hosts + "\n" + authScheme + "\n" + auth;
+}
+
+vector<MountConfig> readMountConfig(const string &file, const MountConfig &defaults) {
+    ifstream input(file.c_str());
+    if (!input) {
+        throw MountConfigException("Could not open the mount file " + file);
+    }
+
+    vector<MountConfig> retval;
+    string line;
+    for (size_t number = 1; getline(input, line); number++) {
+        istringstream fields(line);
+        string field;
+        if (!(fields >> field) || field[0] == '#') {
+            continue;
+        }
+
+        ostringstream location;
+        location << file << ":" << number << ": ";
+        MountConfig mount = defaults;
+        mount.mountPoint.clear();
+        do {
+            size_t equals = field.find('=');
+            if (equals == string::npos) {
+                throw MountConfigException(location.str() + "expected key=value, got " + field);
+            }
+            string key = field.substr(0, equals);
+            string value = field.substr(equals + 1);
+            if (key == "mountPoint") {
+                mount.mountPoint = value;
+            } else if (key == "zooHosts") {
+                mount.hosts = value;
+            } else if (key == "zooPath") {
+                mount.zooPath = value;
+            } else if (key == "zooAuthScheme") {
+                mount.authScheme = value;
+            } else if (key == "zooAuthentication") {
+                mount.auth = value;
+            } else if (key == "leafMode") {
+                mount.leafMode = value != "FILE" ? LEAF_AS_DIR : LEAF_AS_FILE;
+            } else if (key == "maxFileSize") {
+                mount.maxFileSize = atoi(value.c_str());
+            } else if (key == "fuseOptions") {
+                mount.fuseOptions = value;
+            } else {
+                throw MountConfigException(location.str() + "unknown key " + key);
+            }
+        } while (fields >> field);
+
+        // The daemon leaves its working directory when it detaches
+        if (mount.mountPoint.empty() || mount.mountPoint[0] != '/') {
+            throw MountConfigException(location.str() + "mountPoint must be an absolute path");
+        }
+        if (mount.hosts.empty()) {
+            throw MountConfigException(location.str() + "no zooHosts given");
+        }
+        retval.push_back(mount);
+    }
+    return retval;
+}
+
+struct Mount {
+    Mount() :
+    channel(NULL), fuse(NULL), released(false) {
+
+    }
+
+    string point;
+    struct fuse_chan* channel;
+    struct fuse* fuse;
+    // Set once the loop returned, the mount is gone by then
+    bool released;
+};
+
+struct Serving {
+    boost::mutex mutex;
+    size_t running;
+};
+
+static void serve(Mount* mount, Serving* serving, bool multithreaded) {
+    if (multithreaded) {
+        fuse_loop_mt(mount->fuse);
+    } else {
+        fuse_loop(mount->fuse);
+    }
+
+    boost::lock_guard<boost::mutex> lock(serving->mutex);
+    mount->released = true;
+    if (--serving->running == 0) {
+        // Wakes the main thread, nothing is left to serve
+        kill(getpid(), SIGTERM);
+    }
+}
+
+static void destroyMounts(vector<Mount> &mounts) {
+    for (size_t i = 0; i < mounts.size(); i++) {
+        if (mounts[i].fuse != NULL) {
+            fuse_destroy(mounts[i].fuse);
+        } else if (mounts[i].channel != NULL) {
+            fuse_unmount(mounts[i].point.c_str(), mounts[i].channel);
+        }
+    }
+}
+
+int runMounts(int argc, char** argv, const vector<MountConfig> &configs, const vector<ZookeeperFuseContext*> &contexts,
+              const struct fuse_operations *operations) {
+    struct fuse_args shared = FUSE_ARGS_INIT(argc, argv);
+    char *mountpoint = NULL;
+    int multithreaded = 0;
+    int foreground = 0;
+    if (fuse_parse_cmdline(&shared, &mountpoint, &multithreaded, &foreground) == -1) {
+        return 1;
+    }
+    if (mountpoint != NULL) {
+        cerr << "Mount points are read from the mount file, " << mountpoint << " is ignored" << endl;
+        free(mountpoint);
+    }
+
+    vector<Mount> mounts(configs.size());
+    bool mounted = true;
+    for (size_t i = 0; i < configs.size() && mounted; i++) {
+        struct fuse_args args = FUSE_ARGS_INIT(0, NULL);
+        for (int j = 0; j < shared.argc; j++) {
+            fuse_opt_add_arg(&args, shared.argv[j]);
+        }
+        if (!configs[i].fuseOptions.empty()) {
+            fuse_opt_add_arg(&args, "-o");
+            fuse_opt_add_arg(&args, configs[i].fuseOptions.c_str());
+        }
+
+        mounts[i].point = configs[i].mountPoint;
+        mounts[i].channel = fuse_mount(mounts[i].point.c_str(), &args);
+        if (mounts[i].channel != NULL) {
+            mounts[i].fuse = fuse_new(mounts[i].channel, &args, operations, sizeof(*operations), contexts[i]);
+        }
+        fuse_opt_free_args(&args);
+
+        if (mounts[i].fuse == NULL) {
+            cerr << "Could not mount " << mounts[i].point << endl;
+            mounted = false;
+        }
+    }
+    fuse_opt_free_args(&shared);
+    if (!mounted) {
+        destroyMounts(mounts);
+        return 1;
+    }
+
+    fuse_daemonize(foreground);
+
+    // Only the main thread takes termination signals, through sigwait, the loops never see them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Serving serving;
+    serving.running = mounts.size();
+    boost::thread_group loops;
+    for (size_t i = 0; i < mounts.size(); i++) {
+        loops.create_thread(boost::bind(serve, &mounts[i], &serving, multithreaded != 0));
+    }
+
+    int received;
+    sigwait(&signals, &received);
+
+    {
+        // Unmounting aborts the connection, which ends the loop serving it
+        boost::lock_guard<boost::mutex> lock(serving.mutex);
+        for (size_t i = 0; i < mounts.size(); i++) {
+            if (!mounts[i].released) {
+                fuse_unmount(mounts[i].point.c_str(), NULL);
+            }
+        }
+    }
+    loops.join_all();
+    destroyMounts(mounts);
+    return 0;
+}
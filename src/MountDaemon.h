@@ -0,0 +1,89 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   MountDaemon.h
+ * Author: kyle
+ *
+ * Created on October 26, 2026, 4:20 PM
+ */
+
+#ifndef MOUNTDAEMON_H
+#define MOUNTDAEMON_H
+
+#include <string>
+#include <vector>
+
+#include "ZookeeperFuseContext.h"
+
+using namespace std;
+
+class MountConfigException : public std::exception {
+public:
+    MountConfigException(string msg) :
+    msg_(msg) {
+
+    }
+
+    virtual ~MountConfigException() throw() {
+
+    }
+
+    virtual const char* what() const throw()
+    {
+      return msg_.c_str();
+    }
+
+private:
+    string msg_;
+};
+
+// One mount point served by the daemon
+struct MountConfig {
+    MountConfig();
+
+    string mountPoint;
+    string hosts;
+    string authScheme;
+    string auth;
+    string zooPath;
+    LeafMode leafMode;
+    size_t maxFileSize;
+    // Comma separated fuse options of this mount alone, as given to -o
+    string fuseOptions;
+
+    // Mounts with the same key connect as the same client to the same ensemble, so they can share a session
+    string getEnsembleKey() const;
+};
+
+/*
+ * Reads the mount file, one mount per line as whitespace separated key=value pairs:
+ *
+ *   mountPoint=/mnt/config zooHosts=zk1:2181,zk2:2181 zooPath=/config leafMode=FILE fuseOptions=allow_other
+ *
+ * Other keys are zooAuthScheme, zooAuthentication and maxFileSize. Keys left out take their value from
+ * defaults, empty lines and lines starting with # are skipped. Mount points must be absolute.
+ */
+vector<MountConfig> readMountConfig(const string &file, const MountConfig &defaults);
+
+/*
+ * Serves every mount from this process through the high level api, contexts[i] serving mounts[i].
+ *
+ * The fuse arguments (everything before the "--" divider) apply to every mount and must not name a mount
+ * point. Blocks until SIGINT, SIGTERM or SIGHUP, or until every mount has been released.
+ */
+int runMounts(int argc, char** argv, const vector<MountConfig> &mounts, const vector<ZookeeperFuseContext*> &contexts,
+              const struct fuse_operations *operations);
+
+#endif /* MOUNTDAEMON_H */
@@ -0,0 +1,419 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   NodeStore.cpp
+ * Author: kyle
+ *
+ * Created on October 20, 2026, 9:40 AM
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <boost/functional/hash.hpp>
+
+#include "NodeStore.h"
+
+static const uint32_t NO_NODE = 0xffffffff;
+static const uint32_t NO_NAME = 0xffffffff;
+static const uint32_t ROOT = 0;
+
+// Payloads up to MAX_BLOCK bytes are carved from slabs in power of two size classes
+static const size_t SLAB_SIZE = 64 * 1024;
+static const size_t MIN_BLOCK = 32;
+static const size_t MAX_BLOCK = 4096;
+static const size_t SIZE_CLASSES = 8;
+
+// Nodes without payload still cost memory, cap them at roughly one per 64 bytes of budget
+static const size_t MIN_NODES = 1024;
+static const size_t BYTES_PER_NODE = 64;
+
+static size_t sizeClass(size_t length) {
+    size_t retval = 0;
+    for (size_t size = MIN_BLOCK; size < length; size <<= 1) {
+        retval++;
+    }
+    return retval;
+}
+
+NodeStore::Node::Node() :
+name(NO_NAME), parent(NO_NODE), stamp(0), invalidated(0), length(0), flags(0) {
+    payload.block = NULL;
+}
+
+size_t NodeStore::NameHash::operator()(const string &name) const {
+    return boost::hash_range(name.begin(), name.end());
+}
+
+size_t NodeStore::NameHash::operator()(const NameRef &name) const {
+    return boost::hash_range(name.data, name.data + name.length);
+}
+
+bool NodeStore::NameEqual::operator()(const string &lhs, const string &rhs) const {
+    return lhs == rhs;
+}
+
+bool NodeStore::NameEqual::operator()(const NameRef &lhs, const string &rhs) const {
+    return lhs.length == rhs.length() && memcmp(lhs.data, rhs.data(), lhs.length) == 0;
+}
+
+NodeStore::NodeStore(size_t budget) :
+budget_(budget),
+maxNodes_(std::max(MIN_NODES, budget / BYTES_PER_NODE)),
+nodes_(1),
+liveNodes_(1),
+freeBlocks_(SIZE_CLASSES, static_cast<char*>(NULL)),
+largeBytes_(0),
+bytes_(0),
+unreadBytes_(0),
+sequence_(0),
+hand_(0) {
+
+}
+
+NodeStore::~NodeStore() {
+    clear();
+    for (size_t i = 0; i < slabs_.size(); i++) {
+        delete[] slabs_[i];
+    }
+}
+
+uint32_t NodeStore::findName(const NameRef &name) const {
+    NameMap::const_iterator it = names_.find(name, NameHash(), NameEqual());
+    return it == names_.end() ? NO_NAME : it->second;
+}
+
+uint32_t NodeStore::acquireName(const NameRef &name) {
+    uint32_t retval = findName(name);
+    if (retval == NO_NAME) {
+        if (freeNames_.empty()) {
+            retval = nameStrings_.size();
+            nameStrings_.push_back(NULL);
+            nameRefs_.push_back(0);
+        } else {
+            retval = freeNames_.back();
+            freeNames_.pop_back();
+        }
+        NameMap::iterator it = names_.insert(std::make_pair(string(name.data, name.length), retval)).first;
+        nameStrings_[retval] = &it->first;
+    }
+    nameRefs_[retval]++;
+    return retval;
+}
+
+void NodeStore::releaseName(uint32_t name) {
+    if (--nameRefs_[name] == 0) {
+        names_.erase(*nameStrings_[name]);
+        nameStrings_[name] = NULL;
+        freeNames_.push_back(name);
+    }
+}
+
+uint32_t NodeStore::findChild(uint32_t node, uint32_t name) const {
+    const vector<uint32_t> &children = nodes_[node].children;
+    vector<uint32_t>::const_iterator it = std::lower_bound(children.begin(), children.end(), name, ChildLess(nodes_));
+    return it != children.end() && nodes_[*it].name == name ? *it : NO_NODE;
+}
+
+uint32_t NodeStore::addChild(uint32_t node, uint32_t name) {
+    uint32_t retval;
+    if (freeNodes_.empty()) {
+        retval = nodes_.size();
+        nodes_.push_back(Node());
+    } else {
+        retval = freeNodes_.back();
+        freeNodes_.pop_back();
+        nodes_[retval] = Node();
+    }
+    nodes_[retval].name = name;
+    nodes_[retval].parent = node;
+    liveNodes_++;
+
+    vector<uint32_t> &children = nodes_[node].children;
+    children.insert(std::lower_bound(children.begin(), children.end(), name, ChildLess(nodes_)), retval);
+    return retval;
+}
+
+void NodeStore::freeNode(uint32_t node) {
+    Node &freed = nodes_[node];
+    dropContent(freed);
+
+    vector<uint32_t> &siblings = nodes_[freed.parent].children;
+    siblings.erase(std::lower_bound(siblings.begin(), siblings.end(), freed.name, ChildLess(nodes_)));
+    releaseName(freed.name);
+
+    vector<uint32_t>().swap(freed.children);
+    freed.flags = FREE;
+    freeNodes_.push_back(node);
+    liveNodes_--;
+}
+
+uint32_t NodeStore::walk(const string &path, bool create, uint32_t &invalidated) {
+    uint32_t node = ROOT;
+    invalidated = nodes_[ROOT].invalidated;
+
+    size_t start = 0;
+    while (start < path.length()) {
+        size_t end = path.find('/', start);
+        if (end == string::npos) {
+            end = path.length();
+        }
+        if (end > start) {
+            NameRef component(path.data() + start, end - start);
+            uint32_t name = findName(component);
+            uint32_t child = name == NO_NAME ? NO_NODE : findChild(node, name);
+            if (child == NO_NODE) {
+                if (!create) {
+                    return NO_NODE;
+                }
+                child = addChild(node, acquireName(component));
+            }
+            node = child;
+            invalidated = std::max(invalidated, nodes_[node].invalidated);
+        }
+        start = end + 1;
+    }
+    return node;
+}
+
+uint32_t NodeStore::find(const string &path, uint32_t &invalidated) const {
+    return const_cast<NodeStore*>(this)->walk(path, false, invalidated);
+}
+
+bool NodeStore::isCurrent(uint32_t node) const {
+    uint32_t stamp = nodes_[node].stamp;
+    for (uint32_t it = node; it != NO_NODE; it = nodes_[it].parent) {
+        if (nodes_[it].invalidated >= stamp) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t NodeStore::nextSequence() {
+    if (sequence_ == 0xffffffff) {
+        // Stamps can no longer be ordered, start over
+        clear();
+    }
+    return ++sequence_;
+}
+
+size_t NodeStore::blockSize(size_t length) {
+    if (length <= INLINE_SIZE) {
+        return 0;
+    }
+    return length <= MAX_BLOCK ? MIN_BLOCK << sizeClass(length) : length;
+}
+
+char* NodeStore::allocate(size_t length) {
+    if (length > MAX_BLOCK) {
+        largeBytes_ += length;
+        return new char[length];
+    }
+
+    size_t index = sizeClass(length);
+    if (freeBlocks_[index] == NULL) {
+        size_t size = MIN_BLOCK << index;
+        char* slab = new char[SLAB_SIZE];
+        slabs_.push_back(slab);
+        for (size_t offset = 0; offset + size <= SLAB_SIZE; offset += size) {
+            deallocate(slab + offset, size);
+        }
+    }
+    char* retval = freeBlocks_[index];
+    freeBlocks_[index] = *reinterpret_cast<char**>(retval);
+    return retval;
+}
+
+void NodeStore::deallocate(char *block, size_t length) {
+    if (length > MAX_BLOCK) {
+        largeBytes_ -= length;
+        delete[] block;
+        return;
+    }
+
+    // Free blocks are linked through their first bytes
+    size_t index = sizeClass(length);
+    *reinterpret_cast<char**>(block) = freeBlocks_[index];
+    freeBlocks_[index] = block;
+}
+
+const char* NodeStore::payload(const Node &node) const {
+    return node.length <= INLINE_SIZE ? node.payload.bytes : node.payload.block;
+}
+
+void NodeStore::dropContent(Node &node) {
+    if (!(node.flags & HAS_CONTENT)) {
+        return;
+    }
+    if (node.length > INLINE_SIZE) {
+        deallocate(node.payload.block, node.length);
+        node.payload.block = NULL;
+    }
+    bytes_ -= blockSize(node.length);
+    if (node.flags & UNREAD) {
+        unreadBytes_ -= node.length;
+    }
+    node.flags &= ~(HAS_CONTENT | UNREAD);
+}
+
+bool NodeStore::get(const string &path, string &content) {
+    uint32_t invalidated;
+    uint32_t node = walk(path, false, invalidated);
+    if (node == NO_NODE || !(nodes_[node].flags & HAS_CONTENT) || nodes_[node].stamp <= invalidated) {
+        return false;
+    }
+
+    Node &found = nodes_[node];
+    content.assign(payload(found), found.length);
+    found.flags |= REFERENCED;
+    if (found.flags & UNREAD) {
+        found.flags &= ~UNREAD;
+        unreadBytes_ -= found.length;
+    }
+    return true;
+}
+
+bool NodeStore::getLength(const string &path, size_t &length) {
+    uint32_t invalidated;
+    uint32_t node = walk(path, false, invalidated);
+    if (node == NO_NODE || !(nodes_[node].flags & HAS_LENGTH) || nodes_[node].stamp <= invalidated) {
+        return false;
+    }
+    nodes_[node].flags |= REFERENCED;
+    length = nodes_[node].length;
+    return true;
+}
+
+bool NodeStore::contains(const string &path) const {
+    uint32_t invalidated;
+    uint32_t node = find(path, invalidated);
+    return node != NO_NODE && (nodes_[node].flags & HAS_CONTENT) && nodes_[node].stamp > invalidated;
+}
+
+void NodeStore::put(const string &path, const string &content, bool unread) {
+    uint32_t stamp = nextSequence();
+    uint32_t invalidated;
+    uint32_t node = walk(path, true, invalidated);
+
+    Node &stored = nodes_[node];
+    dropContent(stored);
+    stored.stamp = stamp;
+    stored.length = content.length();
+    stored.flags |= HAS_LENGTH | REFERENCED;
+
+    // Too large payloads only leave their length behind
+    if (blockSize(content.length()) <= budget_) {
+        char* target = stored.payload.bytes;
+        if (content.length() > INLINE_SIZE) {
+            target = stored.payload.block = allocate(content.length());
+        }
+        memcpy(target, content.data(), content.length());
+        stored.flags |= HAS_CONTENT;
+        bytes_ += blockSize(content.length());
+        if (unread) {
+            stored.flags |= UNREAD;
+            unreadBytes_ += content.length();
+        }
+    }
+    evict();
+}
+
+void NodeStore::invalidate(const string &path) {
+    uint32_t invalidated;
+    uint32_t node = find(path, invalidated);
+    if (node != NO_NODE) {
+        dropContent(nodes_[node]);
+        nodes_[node].flags &= ~HAS_LENGTH;
+    }
+}
+
+void NodeStore::invalidateSubtree(const string &path) {
+    uint32_t invalidated;
+    uint32_t node = find(path, invalidated);
+    if (node != NO_NODE) {
+        uint32_t stamp = nextSequence();
+        // clear() may have run for the new sequence number, in which case the node is gone already
+        if (node < nodes_.size()) {
+            dropContent(nodes_[node]);
+            nodes_[node].invalidated = stamp;
+        }
+    }
+}
+
+void NodeStore::clear() {
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        dropContent(nodes_[i]);
+    }
+    nodes_.assign(1, Node());
+    freeNodes_.clear();
+    liveNodes_ = 1;
+    names_.clear();
+    nameStrings_.clear();
+    nameRefs_.clear();
+    freeNames_.clear();
+    sequence_ = 0;
+    hand_ = 0;
+}
+
+void NodeStore::evict() {
+    size_t steps = 0;
+    size_t limit = 2 * nodes_.size();
+    while ((bytes_ > budget_ || liveNodes_ > maxNodes_) && steps++ < limit) {
+        hand_ = (hand_ + 1) % nodes_.size();
+        Node &node = nodes_[hand_];
+        if (hand_ == ROOT || (node.flags & FREE)) {
+            continue;
+        }
+        if (node.flags & REFERENCED) {
+            node.flags &= ~REFERENCED;
+        } else if (node.flags & HAS_CONTENT) {
+            dropContent(node);
+        } else if (node.children.empty() && (liveNodes_ > maxNodes_ || !(node.flags & HAS_LENGTH) || !isCurrent(hand_))) {
+            freeNode(hand_);
+        }
+    }
+}
+
+size_t NodeStore::getBudget() const {
+    return budget_;
+}
+
+size_t NodeStore::getBytes() const {
+    return bytes_;
+}
+
+size_t NodeStore::getUnreadBytes() const {
+    return unreadBytes_;
+}
+
+size_t NodeStore::getNodeCount() const {
+    return liveNodes_;
+}
+
+size_t NodeStore::getMemoryUsage() const {
+    size_t retval = nodes_.capacity() * sizeof(Node) + freeNodes_.capacity() * sizeof(uint32_t);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        retval += nodes_[i].children.capacity() * sizeof(uint32_t);
+    }
+    // Each interned name costs its characters plus a hash node holding the string and id
+    for (NameMap::const_iterator it = names_.begin(); it != names_.end(); ++it) {
+        retval += it->first.capacity() + sizeof(NameMap::value_type) + 2 * sizeof(void*);
+    }
+    retval += names_.bucket_count() * sizeof(void*);
+    retval += nameStrings_.capacity() * sizeof(string*) + (nameRefs_.capacity() + freeNames_.capacity()) * sizeof(uint32_t);
+    retval += slabs_.size() * SLAB_SIZE + largeBytes_;
+    return retval;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   NodeStore.h
+ * Author: kyle
+ *
+ * Created on October 20, 2026, 9:40 AM
+ */
+
+#ifndef NODESTORE_H
+#define NODESTORE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+using namespace std;
+
+/*
+ * In memory copy of node contents, indexed by a trie of interned path components.
+ *
+ * Every node is one fixed size record holding its name id, payload length and either the payload itself,
+ * when it is tiny, or a pointer into size classed slabs. Lookups cost one probe per path component.
+ * Invalidating a subtree only stamps its root, nodes filled before the stamp read as missing and are
+ * reclaimed lazily. A CLOCK sweep drops cold payloads when over the byte budget, keeping the length, and
+ * drops empty leaves when there are too many nodes.
+ *
+ * Not thread safe, callers serialise access.
+ */
+class NodeStore {
+public:
+    static const size_t INLINE_SIZE = 16;
+
+    NodeStore(size_t budget);
+    virtual ~NodeStore();
+
+    // Payload of the node, false if it was never stored, invalidated or evicted
+    bool get(const string &path, string &content);
+    // Length of the payload, known until invalidated even after the payload was evicted
+    bool getLength(const string &path, size_t &length);
+    bool contains(const string &path) const;
+    // unread payloads are counted by getUnreadBytes until the first get
+    void put(const string &path, const string &content, bool unread);
+    void invalidate(const string &path);
+    void invalidateSubtree(const string &path);
+    void clear();
+
+    size_t getBudget() const;
+    size_t getBytes() const;
+    size_t getUnreadBytes() const;
+    size_t getNodeCount() const;
+    // Approximation of the heap used by the store, including the trie and name table
+    size_t getMemoryUsage() const;
+
+private:
+    NodeStore(const NodeStore& orig);
+    NodeStore& operator=(const NodeStore &rhs);
+
+    enum Flags {
+        HAS_LENGTH = 1,
+        HAS_CONTENT = 2,
+        REFERENCED = 4,
+        UNREAD = 8,
+        FREE = 16
+    };
+
+    struct Node {
+        Node();
+
+        uint32_t name;
+        uint32_t parent;
+        // Sequence number of the last put, and of the last invalidation of the subtree below the node
+        uint32_t stamp;
+        uint32_t invalidated;
+        uint32_t length;
+        uint8_t flags;
+        union {
+            char bytes[INLINE_SIZE];
+            char* block;
+        } payload;
+        // Sorted by name id
+        vector<uint32_t> children;
+    };
+
+    struct NameRef {
+        NameRef(const char *data, size_t length) :
+        data(data), length(length) {
+
+        }
+
+        const char *data;
+        size_t length;
+    };
+
+    struct NameHash {
+        size_t operator()(const string &name) const;
+        size_t operator()(const NameRef &name) const;
+    };
+
+    struct NameEqual {
+        bool operator()(const string &lhs, const string &rhs) const;
+        bool operator()(const NameRef &lhs, const string &rhs) const;
+    };
+
+    struct ChildLess {
+        ChildLess(const vector<Node> &nodes) :
+        nodes(nodes) {
+
+        }
+
+        bool operator()(uint32_t child, uint32_t name) const {
+            return nodes[child].name < name;
+        }
+
+        const vector<Node> &nodes;
+    };
+
+    typedef boost::unordered_map<string, uint32_t, NameHash, NameEqual> NameMap;
+
+    uint32_t findName(const NameRef &name) const;
+    uint32_t acquireName(const NameRef &name);
+    void releaseName(uint32_t name);
+
+    uint32_t walk(const string &path, bool create, uint32_t &invalidated);
+    uint32_t find(const string &path, uint32_t &invalidated) const;
+    uint32_t findChild(uint32_t node, uint32_t name) const;
+    uint32_t addChild(uint32_t node, uint32_t name);
+    void freeNode(uint32_t node);
+    bool isCurrent(uint32_t node) const;
+    uint32_t nextSequence();
+
+    static size_t blockSize(size_t length);
+    char* allocate(size_t length);
+    void deallocate(char *block, size_t length);
+    const char* payload(const Node &node) const;
+    void dropContent(Node &node);
+    void evict();
+
+    const size_t budget_;
+    const size_t maxNodes_;
+    vector<Node> nodes_;
+    vector<uint32_t> freeNodes_;
+    size_t liveNodes_;
+    NameMap names_;
+    vector<const string*> nameStrings_;
+    vector<uint32_t> nameRefs_;
+    vector<uint32_t> freeNames_;
+    vector<char*> slabs_;
+    vector<char*> freeBlocks_;
+    size_t largeBytes_;
+    size_t bytes_;
+    size_t unreadBytes_;
+    uint32_t sequence_;
+    size_t hand_;
+};
+
+#endif /* NODESTORE_H */
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   PollRegistry.cpp
+ * Author: kyle
+ *
+ * Created on October 26, 2026, 10:15 AM
+ */
+#define FUSE_USE_VERSION 26
+
+#include <poll.h>
+#include <fuse_lowlevel.h>
+
+#include "PollRegistry.h"
+
+static const unsigned READABLE = POLLIN | POLLRDNORM;
+// Writes never block, only readability waits for a change
+static const unsigned WRITABLE = POLLOUT | POLLWRNORM;
+
+PollRegistry::Waiters::Waiters() :
+changed(0), mzxid(-1), armed(false), files(0) {
+
+}
+
+PollRegistry::PollRegistry() :
+generation_(0), wakeups_(0) {
+
+}
+
+PollRegistry::~PollRegistry() {
+    for (map<string, Waiters>::iterator it = waiters_.begin(); it != waiters_.end(); ++it) {
+        for (size_t i = 0; i < it->second.handles.size(); i++) {
+            fuse_pollhandle_destroy(it->second.handles[i]);
+        }
+    }
+}
+
+void PollRegistry::watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx) {
+    PollRegistry* registry = reinterpret_cast<PollRegistry*>(watcherCtx);
+    if (type == ZOO_SESSION_EVENT) {
+        if (state == ZOO_EXPIRED_SESSION_STATE) {
+            registry->reset();
+        }
+        return;
+    }
+    registry->wake(path);
+}
+
+uint64_t PollRegistry::getGeneration() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return generation_;
+}
+
+void PollRegistry::markRead(uint64_t &seen) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    seen = generation_;
+}
+
+void PollRegistry::release(map<string, Waiters>::iterator it) {
+    if (--it->second.files > 0) {
+        return;
+    }
+    // Handles left behind belong to released files, nobody polls them anymore
+    for (size_t i = 0; i < it->second.handles.size(); i++) {
+        fuse_pollhandle_destroy(it->second.handles[i]);
+    }
+    waiters_.erase(it);
+}
+
+void PollRegistry::detach(string &attached) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (attached.empty()) {
+        return;
+    }
+    map<string, Waiters>::iterator it = waiters_.find(attached);
+    if (it != waiters_.end()) {
+        release(it);
+    }
+    attached.clear();
+}
+
+unsigned PollRegistry::poll(zhandle_t *zh, const string &path, const uint64_t &seen, string &attached, struct fuse_pollhandle *ph) {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        if (attached != path) {
+            // Renamed files move to their new node
+            if (!attached.empty()) {
+                map<string, Waiters>::iterator it = waiters_.find(attached);
+                if (it != waiters_.end()) {
+                    release(it);
+                }
+            }
+            waiters_[path].files++;
+            attached = path;
+        }
+        Waiters &waiters = waiters_[path];
+        if (waiters.changed > seen) {
+            if (ph != NULL) {
+                fuse_pollhandle_destroy(ph);
+            }
+            return READABLE | WRITABLE;
+        }
+        if (waiters.armed) {
+            if (ph != NULL) {
+                waiters.handles.push_back(ph);
+            }
+            return WRITABLE;
+        }
+        waiters.armed = true;
+    }
+
+    // The watch fires on the completion thread, which takes the lock, so it is not held while waiting
+    Stat stat;
+    int rc = zoo_wexists(zh, path.c_str(), watcher, this, &stat);
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    // The file stays attached, so the entry is still there
+    Waiters &waiters = waiters_[path];
+    bool ready;
+    if (rc == ZOK || rc == ZNONODE) {
+        int64_t mzxid = rc == ZOK ? stat.mzxid : 0;
+        ready = waiters.changed > seen || waiters.mzxid != mzxid;
+        waiters.mzxid = mzxid;
+    } else {
+        // Nothing will wake the file, let it read and find out
+        waiters.armed = false;
+        ready = true;
+    }
+
+    if (ready) {
+        if (ph != NULL) {
+            fuse_pollhandle_destroy(ph);
+        }
+        return READABLE | WRITABLE;
+    }
+    if (ph != NULL) {
+        waiters.handles.push_back(ph);
+    }
+    return WRITABLE;
+}
+
+void PollRegistry::wake(const string &path) {
+    vector<struct fuse_pollhandle*> handles;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        map<string, Waiters>::iterator it = waiters_.find(path);
+        if (it == waiters_.end()) {
+            return;
+        }
+        it->second.armed = false;
+        it->second.changed = ++generation_;
+        handles.swap(it->second.handles);
+        wakeups_ += handles.size();
+    }
+    notify(handles);
+}
+
+void PollRegistry::reset() {
+    vector<struct fuse_pollhandle*> handles;
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        generation_++;
+        for (map<string, Waiters>::iterator it = waiters_.begin(); it != waiters_.end(); ++it) {
+            it->second.armed = false;
+            it->second.changed = generation_;
+            handles.insert(handles.end(), it->second.handles.begin(), it->second.handles.end());
+            it->second.handles.clear();
+        }
+        wakeups_ += handles.size();
+    }
+    notify(handles);
+}
+
+void PollRegistry::notify(const vector<struct fuse_pollhandle*> &handles) {
+    for (size_t i = 0; i < handles.size(); i++) {
+        fuse_lowlevel_notify_poll(handles[i]);
+        fuse_pollhandle_destroy(handles[i]);
+    }
+}
+
+uint64_t PollRegistry::getWakeups() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return wakeups_;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   PollRegistry.h
+ * Author: kyle
+ *
+ * Created on October 26, 2026, 10:15 AM
+ */
+
+#ifndef POLLREGISTRY_H
+#define POLLREGISTRY_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <zookeeper/zookeeper.h>
+
+struct fuse_pollhandle;
+
+using namespace std;
+
+/*
+ * Wakes poll, select and epoll on open files when their node changes.
+ *
+ * The first poll of a node registers an exists watch through PollRegistry::watcher, later polls wait on
+ * it without any zookeeper traffic. Every change fired by a watch is stamped with a generation, an open
+ * file keeps the generation of its last read and reads as POLLIN once the node changed after it.
+ * Watches that are armed anew can not tell what happened while none was registered, so they report
+ * POLLIN when the node was modified since the previous watch was armed, at worst causing one extra read.
+ * A node is only tracked while open files which polled it remain, they detach from it when released.
+ */
+class PollRegistry {
+public:
+    PollRegistry();
+    virtual ~PollRegistry();
+
+    // Taken when a file is opened
+    uint64_t getGeneration() const;
+    // Updates the generation an open file has seen, before it reads the node
+    void markRead(uint64_t &seen);
+
+    // Events of an open file which has seen the given generation. Without POLLIN, ph is kept and notified
+    // when the node changes, otherwise it is destroyed. ph may be NULL. attached is the node the file last
+    // polled, empty before its first poll, and is moved to path
+    unsigned poll(zhandle_t *zh, const string &path, const uint64_t &seen, string &attached, struct fuse_pollhandle *ph);
+    // Called when a file is released, the node is forgotten once no open file polled it
+    void detach(string &attached);
+    // Wakes every waiter, the watches are gone with the session
+    void reset();
+
+    uint64_t getWakeups() const;
+
+    // Watcher of the exists calls arming the polls, its context must be the registry
+    static void watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx);
+
+private:
+    PollRegistry(const PollRegistry& orig);
+    PollRegistry& operator=(const PollRegistry &rhs);
+
+    struct Waiters {
+        Waiters();
+
+        // Generation of the last change fired for the node
+        uint64_t changed;
+        // Modification of the node when its watch was last armed, -1 before the first one
+        int64_t mzxid;
+        bool armed;
+        // Open files attached to the node
+        size_t files;
+        vector<struct fuse_pollhandle*> handles;
+    };
+
+    void wake(const string &path);
+    void release(map<string, Waiters>::iterator it);
+    void notify(const vector<struct fuse_pollhandle*> &handles);
+
+    mutable boost::mutex mutex_;
+    // One small entry per node polled by open files
+    map<string, Waiters> waiters_;
+    uint64_t generation_;
+    uint64_t wakeups_;
+};
+
+#endif /* POLLREGISTRY_H */
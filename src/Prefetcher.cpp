@@ -0,0 +1,246 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Prefetcher.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 3:15 PM
+ */
+
+#include <algorithm>
+
+#include "Prefetcher.h"
+#include "ChunkManifest.h"
+#include "ZookeeperFuseContext.h"
+#include "codec/Codec.h"
+
+const size_t Prefetcher::WINDOW = 8;
+const size_t Prefetcher::MAX_SCANS = 16;
+
+static string parentOf(const string &path, string &name) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) {
+        name = path;
+        return "";
+    }
+    name = path.substr(slash + 1);
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static string childOf(const string &directory, const string &name) {
+    return directory == "/" ? directory + name : directory + "/" + name;
+}
+
+Prefetcher::Prefetcher(ZookeeperFuseContext* context, ContentCache* cache) :
+context_(context), cache_(cache), clock_(0), issued_(0), cancelled_(0) {
+
+}
+
+Prefetcher::~Prefetcher() {
+
+}
+
+Prefetcher::Scan& Prefetcher::touch(const string &directory) {
+    if (scans_.find(directory) == scans_.end() && scans_.size() >= MAX_SCANS) {
+        ScanMap::iterator oldest = scans_.begin();
+        for (ScanMap::iterator it = scans_.begin(); it != scans_.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) {
+                oldest = it;
+            }
+        }
+        // Outstanding fetches of the evicted scan no longer find a matching generation
+        scans_.erase(oldest);
+    }
+    Scan& scan = scans_[directory];
+    scan.lastUsed = ++clock_;
+    return scan;
+}
+
+void Prefetcher::setSiblings(Scan &scan, const String_vector *children) {
+    scan.siblings.clear();
+    for (int i = 0; children != NULL && i < children->count; i++) {
+        if (!ChunkManifest::isChunkName(children->data[i])) {
+            scan.siblings.push_back(children->data[i]);
+        }
+    }
+    std::sort(scan.siblings.begin(), scan.siblings.end());
+    scan.listed = true;
+}
+
+void Prefetcher::cancel(Scan &scan) {
+    if (scan.active) {
+        cancelled_++;
+    }
+    scan.active = false;
+    scan.generation++;
+}
+
+void Prefetcher::onReaddir(const string &path, const vector<string> &children) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    Scan& scan = touch(path);
+    cancel(scan);
+    scan.siblings = children;
+    std::sort(scan.siblings.begin(), scan.siblings.end());
+    scan.listed = true;
+    scan.lastRead.clear();
+    // Reading any child next counts as a scan
+    scan.active = true;
+    scan.position = 0;
+    scan.issued = 0;
+}
+
+void Prefetcher::onRead(const string &path) {
+    string name;
+    string directory = parentOf(path, name);
+    if (directory.empty()) {
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    Scan& scan = touch(directory);
+
+    if (!scan.listed) {
+        if (!scan.lastRead.empty() && scan.lastRead < name && !scan.listing) {
+            // Second sibling read in ascending order, fetch the listing to find what comes next
+            zhandle_t* handle = context_->getZookeeperHandle();
+            Fetch* fetch = new Fetch();
+            fetch->prefetcher = this;
+            fetch->directory = directory;
+            fetch->generation = scan.generation;
+            if (handle != NULL && zoo_aget_children(handle, directory.c_str(), 0, childrenCompletion, fetch) == ZOK) {
+                scan.listing = true;
+            } else {
+                delete fetch;
+            }
+        }
+        scan.lastRead = name;
+        return;
+    }
+
+    vector<string>::iterator it = std::lower_bound(scan.siblings.begin(), scan.siblings.end(), name);
+    if (it == scan.siblings.end() || *it != name) {
+        return;
+    }
+    size_t position = it - scan.siblings.begin();
+
+    if (scan.active && position < scan.position) {
+        // Going backwards breaks the scan, it has to be re-established by the next forward read
+        cancel(scan);
+    }
+    if (!scan.active) {
+        if (scan.lastRead.empty() || position <= scan.position) {
+            scan.position = position;
+            scan.lastRead = name;
+            return;
+        }
+        scan.active = true;
+        scan.issued = position + 1;
+    }
+    advance(directory, scan, position);
+}
+
+void Prefetcher::advance(const string &directory, Scan &scan, size_t position) {
+    scan.position = position;
+    scan.lastRead = scan.siblings[position];
+    if (scan.issued < position + 1) {
+        scan.issued = position + 1;
+    }
+    issue(directory, scan);
+}
+
+void Prefetcher::issue(const string &directory, Scan &scan) {
+    zhandle_t* handle = context_->getZookeeperHandle();
+    if (handle == NULL) {
+        return;
+    }
+
+    size_t end = std::min(scan.siblings.size(), scan.position + 1 + WINDOW);
+    while (scan.issued < end && cache_->getUnreadPrefetchedBytes() < cache_->getBudget()) {
+        string path = childOf(directory, scan.siblings[scan.issued++]);
+        if (cache_->contains(path)) {
+            continue;
+        }
+
+        Fetch* fetch = new Fetch();
+        fetch->prefetcher = this;
+        fetch->directory = directory;
+        fetch->path = path;
+        fetch->generation = scan.generation;
+        if (zoo_awget(handle, path.c_str(), ContentCache::watcher, cache_, dataCompletion, fetch) != ZOK) {
+            delete fetch;
+            break;
+        }
+        issued_++;
+    }
+}
+
+void Prefetcher::dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    Fetch* fetch = const_cast<Fetch*>(reinterpret_cast<const Fetch*>(data));
+    Prefetcher* prefetcher = fetch->prefetcher;
+    size_t length = valueLength > 0 ? valueLength : 0;
+
+    {
+        boost::lock_guard<boost::mutex> lock(prefetcher->mutex_);
+        ScanMap::iterator scan = prefetcher->scans_.find(fetch->directory);
+        ChunkManifest manifest;
+        // Chunked files are left to the range reads of ZooFile
+        if (rc == ZOK && scan != prefetcher->scans_.end() && scan->second.generation == fetch->generation &&
+            !ChunkManifest::decode(value, length, manifest)) {
+            try {
+                size_t maxLength = prefetcher->context_->getFileOptions().maxContentSize;
+                prefetcher->cache_->put(fetch->path, Codec::decode(value, length, maxLength), true);
+            } catch (const CodecException &e) {
+                // Leave it to the regular read to report
+            }
+        }
+    }
+    delete fetch;
+}
+
+void Prefetcher::childrenCompletion(int rc, const struct String_vector *strings, const void *data) {
+    Fetch* fetch = const_cast<Fetch*>(reinterpret_cast<const Fetch*>(data));
+    Prefetcher* prefetcher = fetch->prefetcher;
+
+    {
+        boost::lock_guard<boost::mutex> lock(prefetcher->mutex_);
+        ScanMap::iterator it = prefetcher->scans_.find(fetch->directory);
+        if (rc == ZOK && it != prefetcher->scans_.end() && it->second.generation == fetch->generation) {
+            Scan& scan = it->second;
+            scan.listing = false;
+            prefetcher->setSiblings(scan, strings);
+
+            vector<string>::iterator last = std::lower_bound(scan.siblings.begin(), scan.siblings.end(), scan.lastRead);
+            if (last != scan.siblings.end() && *last == scan.lastRead) {
+                scan.active = true;
+                scan.issued = 0;
+                prefetcher->advance(fetch->directory, scan, last - scan.siblings.begin());
+            }
+        } else if (it != prefetcher->scans_.end()) {
+            it->second.listing = false;
+        }
+    }
+    delete fetch;
+}
+
+uint64_t Prefetcher::getIssued() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return issued_;
+}
+
+uint64_t Prefetcher::getCancelled() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return cancelled_;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Prefetcher.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 3:15 PM
+ */
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <zookeeper/zookeeper.h>
+
+#include "ContentCache.h"
+
+using namespace std;
+
+class ZookeeperFuseContext;
+
+/*
+ * Detects directory scans and loads the remaining siblings into the content cache ahead of the reader.
+ *
+ * A scan starts when a child is read after its directory was listed, or when two siblings are read in
+ * ascending order. The next WINDOW siblings are then fetched asynchronously, as long as the unread
+ * prefetched bytes stay within the cache budget. Reading backwards cancels the scan, results of
+ * cancelled fetches are dropped.
+ */
+class Prefetcher {
+public:
+    static const size_t WINDOW;
+    static const size_t MAX_SCANS;
+
+    Prefetcher(ZookeeperFuseContext* context, ContentCache* cache);
+    virtual ~Prefetcher();
+
+    void onReaddir(const string &path, const vector<string> &children);
+    void onRead(const string &path);
+
+    uint64_t getIssued() const;
+    uint64_t getCancelled() const;
+
+private:
+    Prefetcher(const Prefetcher& orig);
+    Prefetcher& operator=(const Prefetcher &rhs);
+
+    struct Scan {
+        Scan() :
+        listed(false), listing(false), active(false), position(0), issued(0), generation(0), lastUsed(0) {
+
+        }
+
+        vector<string> siblings;
+        bool listed;
+        bool listing;
+        bool active;
+        string lastRead;
+        size_t position;
+        size_t issued;
+        uint64_t generation;
+        uint64_t lastUsed;
+    };
+
+    struct Fetch {
+        Prefetcher* prefetcher;
+        string directory;
+        string path;
+        uint64_t generation;
+    };
+
+    typedef boost::unordered_map<string, Scan> ScanMap;
+
+    Scan& touch(const string &directory);
+    void setSiblings(Scan &scan, const String_vector *children);
+    void advance(const string &directory, Scan &scan, size_t position);
+    void issue(const string &directory, Scan &scan);
+    void cancel(Scan &scan);
+
+    static void dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data);
+    static void childrenCompletion(int rc, const struct String_vector *strings, const void *data);
+
+    ZookeeperFuseContext* context_;
+    ContentCache* cache_;
+    mutable boost::mutex mutex_;
+    ScanMap scans_;
+    uint64_t clock_;
+    uint64_t issued_;
+    uint64_t cancelled_;
+};
+
+#endif /* PREFETCHER_H */
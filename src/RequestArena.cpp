@@ -0,0 +1,90 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   RequestArena.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 12:30 AM
+ */
+
+#include <string.h>
+#include <algorithm>
+
+#include <boost/thread/tss.hpp>
+
+#include "RequestArena.h"
+
+const size_t RequestArena::BLOCK_SIZE = 16384;
+const size_t RequestArena::ALIGNMENT = 16;
+
+static boost::thread_specific_ptr<RequestArena> threadArena;
+
+RequestArena::Scope::Scope() :
+arena_(RequestArena::get()) {
+    arena_.depth_++;
+}
+
+RequestArena::Scope::~Scope() {
+    if (--arena_.depth_ == 0) {
+        arena_.reset();
+    }
+}
+
+RequestArena& RequestArena::get() {
+    RequestArena* arena = threadArena.get();
+    if (arena == NULL) {
+        arena = new RequestArena();
+        threadArena.reset(arena);
+    }
+    return *arena;
+}
+
+RequestArena::RequestArena() :
+blockSize_(BLOCK_SIZE), used_(0), depth_(0) {
+    blocks_.push_back(new char[BLOCK_SIZE]);
+}
+
+RequestArena::~RequestArena() {
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        delete[] blocks_[i];
+    }
+}
+
+void* RequestArena::allocate(size_t size) {
+    size_t start = (used_ + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (start + size > blockSize_) {
+        blockSize_ = std::max(BLOCK_SIZE, size);
+        blocks_.push_back(new char[blockSize_]);
+        start = 0;
+    }
+    used_ = start + size;
+    return blocks_.back() + start;
+}
+
+char* RequestArena::copy(const char *data, size_t length) {
+    char* retval = static_cast<char*>(allocate(length + 1));
+    memcpy(retval, data, length);
+    retval[length] = '\0';
+    return retval;
+}
+
+void RequestArena::reset() {
+    for (size_t i = 1; i < blocks_.size(); i++) {
+        delete[] blocks_[i];
+    }
+    blocks_.resize(1);
+    blockSize_ = BLOCK_SIZE;
+    used_ = 0;
+}
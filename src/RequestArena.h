@@ -0,0 +1,78 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   RequestArena.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 12:30 AM
+ */
+
+#ifndef REQUESTARENA_H
+#define REQUESTARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Bump allocator for the temporaries of a single fuse callback, one per thread.
+ *
+ * Memory handed out stays valid until the outermost Scope of the thread ends, which releases it all at
+ * once. The first block is kept from request to request, so a callback whose temporaries fit in it does not
+ * touch the heap. Allocations made outside of a Scope are only released by the next one to end.
+ */
+class RequestArena {
+public:
+    // Holds the arena of the calling thread for the lifetime of a callback
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+    private:
+        Scope(const Scope& orig);
+        Scope& operator=(const Scope &rhs);
+
+        RequestArena &arena_;
+    };
+
+    static RequestArena& get();
+
+    virtual ~RequestArena();
+
+    void* allocate(size_t size);
+    // Copies length bytes into the arena and terminates them
+    char* copy(const char *data, size_t length);
+
+private:
+    RequestArena();
+    RequestArena(const RequestArena& orig);
+    RequestArena& operator=(const RequestArena &rhs);
+
+    static const size_t BLOCK_SIZE;
+    static const size_t ALIGNMENT;
+
+    void reset();
+
+    // Blocks past the first are sized for what did not fit, the last one is the one being filled
+    vector<char*> blocks_;
+    size_t blockSize_;
+    size_t used_;
+    unsigned int depth_;
+};
+
+#endif /* REQUESTARENA_H */
+
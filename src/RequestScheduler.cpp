@@ -0,0 +1,247 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   RequestScheduler.cpp
+ * Author: kyle
+ *
+ * Created on October 27, 2026, 9:40 AM
+ */
+
+#include <time.h>
+#include <stdlib.h>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/thread/lock_guard.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "RequestScheduler.h"
+
+static const char* CLASS_NAMES[RequestScheduler::CLASS_COUNT] = { "stat", "read", "list", "write" };
+
+// Share of every bucket and of the outstanding slots bulk requests leave to interactive ones
+static const size_t BULK_RESERVE_DIVISOR = 4;
+// Processes tracked for scan detection before idle ones are dropped
+static const size_t MAX_PROCESSES = 4096;
+static const uint64_t WAIT_FOR_CHANGE = static_cast<uint64_t>(-1);
+
+RequestScheduler::ProcessRate::ProcessRate() :
+second(0), current(0), previous(0) {
+
+}
+
+RequestScheduler::RequestScheduler(const double rates[CLASS_COUNT], size_t maxOutstanding, const set<uid_t> &bulkUids,
+                                   unsigned int scanRate) :
+maxOutstanding_(maxOutstanding), bulkUids_(bulkUids), scanRate_(scanRate), outstanding_(0), maxQueued_(0), admitted_(0),
+bulkAdmitted_(0) {
+    uint64_t start = now();
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        buckets_[i].rate = rates[i];
+        buckets_[i].tokens = rates[i];
+        buckets_[i].refilled = start;
+        buckets_[i].throttled = 0;
+    }
+    queued_[INTERACTIVE] = 0;
+    queued_[BULK] = 0;
+}
+
+RequestScheduler::~RequestScheduler() {
+
+}
+
+uint64_t RequestScheduler::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+RequestScheduler::Priority RequestScheduler::classify(pid_t pid, uid_t uid) {
+    if (bulkUids_.count(uid) > 0) {
+        return BULK;
+    }
+    if (scanRate_ == 0) {
+        return INTERACTIVE;
+    }
+
+    uint64_t second = now() / 1000000;
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    if (processes_.size() >= MAX_PROCESSES && processes_.find(pid) == processes_.end()) {
+        for (map<pid_t, ProcessRate>::iterator it = processes_.begin(); it != processes_.end();) {
+            if (it->second.second + 1 < second) {
+                processes_.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    ProcessRate &rate = processes_[pid];
+    if (rate.second != second) {
+        rate.previous = rate.second + 1 == second ? rate.current : 0;
+        rate.current = 0;
+        rate.second = second;
+    }
+    rate.current++;
+    return rate.current > scanRate_ || rate.previous > scanRate_ ? BULK : INTERACTIVE;
+}
+
+uint64_t RequestScheduler::getDelay(OpClass opClass, Priority priority, uint64_t now) {
+    if (priority == BULK && queued_[INTERACTIVE] > 0) {
+        return WAIT_FOR_CHANGE;
+    }
+
+    if (maxOutstanding_ > 0) {
+        size_t slots = maxOutstanding_;
+        if (priority == BULK && slots > 1) {
+            slots -= std::max<size_t>(slots / BULK_RESERVE_DIVISOR, 1);
+        }
+        if (outstanding_ >= slots) {
+            return WAIT_FOR_CHANGE;
+        }
+    }
+
+    Bucket &bucket = buckets_[opClass];
+    if (bucket.rate <= 0) {
+        return 0;
+    }
+    // Buckets hold a second of their rate, and never less than a single request
+    double capacity = std::max(bucket.rate, 1.0);
+    bucket.tokens = std::min(capacity, bucket.tokens + (now - bucket.refilled) * bucket.rate / 1000000);
+    bucket.refilled = now;
+    // The reserve kept for interactive requests must still fit in the bucket, or bulk ones would never pass
+    double needed = priority == BULK ? std::min(1 + capacity / BULK_RESERVE_DIVISOR, capacity) : 1;
+    if (bucket.tokens >= needed) {
+        return 0;
+    }
+    return static_cast<uint64_t>((needed - bucket.tokens) * 1000000 / bucket.rate) + 1;
+}
+
+void RequestScheduler::acquire(OpClass opClass, Priority priority) {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    uint64_t delay = getDelay(opClass, priority, now());
+    if (delay > 0) {
+        buckets_[opClass].throttled++;
+        queued_[priority]++;
+        maxQueued_ = std::max(maxQueued_, queued_[INTERACTIVE] + queued_[BULK]);
+        while (delay > 0) {
+            if (delay == WAIT_FOR_CHANGE) {
+                changed_.wait(lock);
+            } else {
+                changed_.timed_wait(lock, boost::posix_time::microseconds(delay));
+            }
+            delay = getDelay(opClass, priority, now());
+        }
+        queued_[priority]--;
+        // Bulk requests wait for the interactive queue to drain
+        if (priority == INTERACTIVE && queued_[INTERACTIVE] == 0) {
+            changed_.notify_all();
+        }
+    }
+
+    if (buckets_[opClass].rate > 0) {
+        buckets_[opClass].tokens -= 1;
+    }
+    outstanding_++;
+    admitted_++;
+    if (priority == BULK) {
+        bulkAdmitted_++;
+    }
+}
+
+void RequestScheduler::release() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    outstanding_--;
+    changed_.notify_all();
+}
+
+size_t RequestScheduler::getQueued() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return queued_[INTERACTIVE] + queued_[BULK];
+}
+
+size_t RequestScheduler::getMaxQueued() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return maxQueued_;
+}
+
+uint64_t RequestScheduler::getAdmitted() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return admitted_;
+}
+
+uint64_t RequestScheduler::getBulkAdmitted() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return bulkAdmitted_;
+}
+
+uint64_t RequestScheduler::getThrottled(OpClass opClass) const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return buckets_[opClass].throttled;
+}
+
+const char* RequestScheduler::classToString(OpClass opClass) {
+    return CLASS_NAMES[opClass];
+}
+
+bool RequestScheduler::parseRates(const string &spec, double rates[CLASS_COUNT]) {
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        rates[i] = 0;
+    }
+    istringstream input(spec);
+    string item;
+    while (getline(input, item, ',')) {
+        size_t equals = item.find('=');
+        if (equals == string::npos) {
+            return false;
+        }
+        string name = item.substr(0, equals);
+        size_t i = 0;
+        while (i < CLASS_COUNT && name != CLASS_NAMES[i]) {
+            i++;
+        }
+        if (i == CLASS_COUNT) {
+            return false;
+        }
+        rates[i] = atof(item.substr(equals + 1).c_str());
+    }
+    return true;
+}
+
+bool RequestScheduler::parseUids(const string &spec, set<uid_t> &uids) {
+    istringstream input(spec);
+    string item;
+    while (getline(input, item, ',')) {
+        char *end = NULL;
+        unsigned long uid = strtoul(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0') {
+            return false;
+        }
+        uids.insert(static_cast<uid_t>(uid));
+    }
+    return true;
+}
+
+Admission::Admission(RequestScheduler *scheduler, RequestScheduler::OpClass opClass, pid_t pid, uid_t uid) :
+scheduler_(scheduler) {
+    if (scheduler_ != NULL) {
+        scheduler_->acquire(opClass, scheduler_->classify(pid, uid));
+    }
+}
+
+Admission::~Admission() {
+    if (scheduler_ != NULL) {
+        scheduler_->release();
+    }
+}
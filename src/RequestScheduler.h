@@ -0,0 +1,139 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   RequestScheduler.h
+ * Author: kyle
+ *
+ * Created on October 27, 2026, 9:40 AM
+ */
+
+#ifndef REQUESTSCHEDULER_H
+#define REQUESTSCHEDULER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <set>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+using namespace std;
+
+/*
+ * Admission control of the requests a session sends to the zoo.
+ *
+ * Every class of operation draws from a token bucket refilled at its own rate and holding up to one
+ * second of it, and at most maxOutstanding admitted requests run at once. Callers are classified as
+ * interactive or bulk: bulk are the uids listed as such and any process issuing more than scanRate
+ * requests a second, like find or rsync walking the mount. Bulk requests wait while an interactive one is
+ * queued and leave a quarter of every bucket and of the outstanding slots to interactive requests, so a
+ * scan is slowed down rather than the services sharing the session.
+ *
+ * acquire blocks the calling fuse worker, leaving further requests queued in the kernel.
+ */
+class RequestScheduler {
+public:
+    enum OpClass {
+        STAT,
+        READ,
+        LIST,
+        WRITE,
+        CLASS_COUNT
+    };
+
+    enum Priority {
+        INTERACTIVE,
+        BULK
+    };
+
+    // rates are requests per second by class, 0 does not limit. A 0 maxOutstanding or scanRate disables either
+    RequestScheduler(const double rates[CLASS_COUNT], size_t maxOutstanding, const set<uid_t> &bulkUids, unsigned int scanRate);
+    virtual ~RequestScheduler();
+
+    Priority classify(pid_t pid, uid_t uid);
+    void acquire(OpClass opClass, Priority priority);
+    void release();
+
+    size_t getQueued() const;
+    size_t getMaxQueued() const;
+    uint64_t getAdmitted() const;
+    uint64_t getBulkAdmitted() const;
+    // Requests of the class which had to wait for admission
+    uint64_t getThrottled(OpClass opClass) const;
+
+    static const char* classToString(OpClass opClass);
+    // Parses rates such as "stat=2000,read=1000,list=100,write=50", classes left out are not limited
+    static bool parseRates(const string &spec, double rates[CLASS_COUNT]);
+    // Parses a comma separated list of uids
+    static bool parseUids(const string &spec, set<uid_t> &uids);
+
+private:
+    RequestScheduler(const RequestScheduler& orig);
+    RequestScheduler& operator=(const RequestScheduler &rhs);
+
+    struct Bucket {
+        double rate;
+        double tokens;
+        uint64_t refilled;
+        uint64_t throttled;
+    };
+
+    // Requests of a process in the current and the previous second
+    struct ProcessRate {
+        ProcessRate();
+
+        uint64_t second;
+        unsigned int current;
+        unsigned int previous;
+    };
+
+    // Microseconds until the request can be admitted, 0 when it can be now. Requests waiting for a slot or for
+    // the interactive queue to drain get WAIT_FOR_CHANGE
+    uint64_t getDelay(OpClass opClass, Priority priority, uint64_t now);
+
+    static uint64_t now();
+
+    const size_t maxOutstanding_;
+    const set<uid_t> bulkUids_;
+    const unsigned int scanRate_;
+    Bucket buckets_[CLASS_COUNT];
+    map<pid_t, ProcessRate> processes_;
+    size_t outstanding_;
+    size_t queued_[2];
+    size_t maxQueued_;
+    uint64_t admitted_;
+    uint64_t bulkAdmitted_;
+    mutable boost::mutex mutex_;
+    boost::condition_variable changed_;
+};
+
+/*
+ * Holds an admission for the lifetime of a callback, does nothing without a scheduler
+ */
+class Admission {
+public:
+    Admission(RequestScheduler *scheduler, RequestScheduler::OpClass opClass, pid_t pid, uid_t uid);
+    ~Admission();
+
+private:
+    Admission(const Admission& orig);
+    Admission& operator=(const Admission &rhs);
+
+    RequestScheduler *scheduler_;
+};
+
+#endif /* REQUESTSCHEDULER_H */
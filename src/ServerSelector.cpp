@@ -0,0 +1,292 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ServerSelector.cpp
+ * Author: kyle
+ *
+ * Created on October 24, 2026, 11:05 AM
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "ServerSelector.h"
+
+static uint64_t now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+// Waits for events on fd until the deadline, returns false on timeout or error
+static bool waitFor(int fd, short events, uint64_t deadline) {
+    struct pollfd descriptor;
+    descriptor.fd = fd;
+    descriptor.events = events;
+    while (true) {
+        uint64_t current = now();
+        if (current >= deadline) {
+            return false;
+        }
+        int rc = poll(&descriptor, 1, (deadline - current + 999) / 1000);
+        if (rc > 0) {
+            return true;
+        }
+        if (rc == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+static bool byDistance(const ServerSelector::Server &lhs, const ServerSelector::Server &rhs) {
+    return lhs.rtt < rhs.rtt;
+}
+
+ServerSelector::ServerSelector(const string &hosts, Logger &logger) :
+logger_(logger),
+handle_(NULL) {
+    string list = hosts;
+    size_t slash = list.find('/');
+    if (slash != string::npos) {
+        chroot_ = list.substr(slash);
+        list.erase(slash);
+    }
+    size_t start = 0;
+    while (start <= list.length()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) {
+            end = list.length();
+        }
+        if (end > start) {
+            addresses_.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+    all_ = join(addresses_);
+}
+
+ServerSelector::~ServerSelector() {
+    stop();
+}
+
+ServerSelector::Server ServerSelector::probe(const string &address) {
+    Server retval;
+    retval.address = address;
+
+    string host = address;
+    string port = "2181";
+    size_t colon = address.rfind(':');
+    if (colon != string::npos && address.find(']', colon) == string::npos) {
+        host = address.substr(0, colon);
+        port = address.substr(colon + 1);
+    }
+    if (host.length() > 1 && host[0] == '[') {
+        host = host.substr(1, host.length() - 2);
+    }
+
+    struct addrinfo hints;
+    struct addrinfo *resolved = NULL;
+    memset(&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &resolved) != 0 || resolved == NULL) {
+        return retval;
+    }
+
+    int fd = socket(resolved->ai_family, resolved->ai_socktype, resolved->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(resolved);
+        return retval;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    uint64_t start = now();
+    uint64_t deadline = start + PROBE_TIMEOUT_MILLIS * 1000;
+    int rc = connect(fd, resolved->ai_addr, resolved->ai_addrlen);
+    freeaddrinfo(resolved);
+    if (rc != 0 && (errno != EINPROGRESS || !waitFor(fd, POLLOUT, deadline))) {
+        close(fd);
+        return retval;
+    }
+    int error = 0;
+    socklen_t length = sizeof (error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+        close(fd);
+        return retval;
+    }
+    retval.reachable = true;
+    retval.rtt = now() - start;
+
+    // Servers not allowing the four letter word just close the connection, they count as participants
+    string reply;
+    if (write(fd, "srvr", 4) == 4) {
+        char buffer[1024];
+        while (waitFor(fd, POLLIN, deadline)) {
+            ssize_t received = recv(fd, buffer, sizeof (buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            reply.append(buffer, received);
+        }
+    }
+    close(fd);
+    retval.observer = reply.find("Mode: observer") != string::npos;
+    return retval;
+}
+
+static void probeInto(const string &address, ServerSelector::Server *server) {
+    *server = ServerSelector::probe(address);
+}
+
+vector<ServerSelector::Server> ServerSelector::probeAll() const {
+    vector<Server> retval(addresses_.size());
+    boost::thread_group probes;
+    for (size_t i = 0; i < addresses_.size(); i++) {
+        probes.create_thread(boost::bind(probeInto, addresses_[i], &retval[i]));
+    }
+    probes.join_all();
+    return retval;
+}
+
+// Lists come out in address order, so the same servers always give the same list however their round trips
+// ranked them and lists can be compared as sets
+string ServerSelector::join(const vector<string> &addresses) const {
+    vector<string> sorted(addresses);
+    std::sort(sorted.begin(), sorted.end());
+    string retval;
+    for (size_t i = 0; i < sorted.size(); i++) {
+        if (i > 0) {
+            retval += ",";
+        }
+        retval += sorted[i];
+    }
+    return retval + chroot_;
+}
+
+string ServerSelector::choose(const vector<Server> &servers) const {
+    vector<Server> reachable;
+    for (size_t i = 0; i < servers.size(); i++) {
+        if (servers[i].reachable) {
+            reachable.push_back(servers[i]);
+        }
+    }
+    if (reachable.empty()) {
+        return all_;
+    }
+    std::sort(reachable.begin(), reachable.end(), byDistance);
+
+    vector<string> near;
+    vector<string> observers;
+    for (size_t i = 0; i < reachable.size() && reachable[i].rtt <= 2 * reachable[0].rtt + NEAR_SLACK; i++) {
+        near.push_back(reachable[i].address);
+        if (reachable[i].observer) {
+            observers.push_back(reachable[i].address);
+        }
+    }
+    return join(observers.empty() ? near : observers);
+}
+
+string ServerSelector::select() {
+    vector<Server> servers = probeAll();
+    for (size_t i = 0; i < servers.size(); i++) {
+        if (servers[i].reachable) {
+            logger_.log(Logger::INFO, "Server %s: %lu us%s", servers[i].address.c_str(), (unsigned long) servers[i].rtt,
+                        servers[i].observer ? ", observer" : "");
+        } else {
+            logger_.log(Logger::INFO, "Server %s: unreachable", servers[i].address.c_str());
+        }
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    preferred_ = choose(servers);
+    current_ = preferred_;
+    logger_.log(Logger::INFO, "Connecting to the nearest servers: %s", preferred_.c_str());
+    return preferred_;
+}
+
+void ServerSelector::monitor(zhandle_t *handle) {
+    stop();
+    handle_ = handle;
+    thread_ = boost::thread(boost::bind(&ServerSelector::run, this));
+}
+
+void ServerSelector::stop() {
+    if (thread_.joinable()) {
+        thread_.interrupt();
+        thread_.join();
+    }
+    handle_ = NULL;
+}
+
+void ServerSelector::setServers(const string &hosts, const char *reason) {
+    int rc = zoo_set_servers(handle_, hosts.c_str());
+    if (rc != ZOK) {
+        logger_.log(Logger::WARNING, "Could not move the session to %s: %d", hosts.c_str(), rc);
+        return;
+    }
+    logger_.log(Logger::INFO, "Moving the session to %s, %s", hosts.c_str(), reason);
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    current_ = hosts;
+}
+
+void ServerSelector::run() {
+    uint64_t disconnectedSince = 0;
+    uint64_t nextProbe = now() + PROBE_INTERVAL_SECONDS * 1000000ULL;
+    try {
+        while (true) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(250));
+
+            // Read only sessions count as disconnected, the preferred servers may have lost quorum
+            uint64_t current = now();
+            if (zoo_state(handle_) == ZOO_CONNECTED_STATE) {
+                disconnectedSince = 0;
+            } else if (disconnectedSince == 0) {
+                disconnectedSince = current;
+            }
+            if (disconnectedSince != 0 && current - disconnectedSince >= FAILOVER_MILLIS * 1000ULL && current_ != all_) {
+                setServers(all_, "the nearest servers can not be reached");
+            }
+
+            if (current < nextProbe) {
+                continue;
+            }
+            nextProbe = current + PROBE_INTERVAL_SECONDS * 1000000ULL;
+            vector<Server> servers = probeAll();
+            string preferred = choose(servers);
+            {
+                boost::lock_guard<boost::mutex> lock(mutex_);
+                preferred_ = preferred;
+            }
+            if (preferred != current_ && preferred != all_) {
+                setServers(preferred, "they are nearest again");
+                disconnectedSince = 0;
+            }
+        }
+    } catch (boost::thread_interrupted&) {
+
+    }
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ServerSelector.h
+ * Author: kyle
+ *
+ * Created on October 24, 2026, 11:05 AM
+ */
+
+#ifndef SERVERSELECTOR_H
+#define SERVERSELECTOR_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <zookeeper/zookeeper.h>
+
+#include "logger/Logger.h"
+
+using namespace std;
+
+/*
+ * Steers the session towards the nearest servers of the ensemble.
+ *
+ * Every listed server is probed with a TCP connect, its round trip taken as the distance, and asked for
+ * its mode with the srvr four letter word. Servers within twice the best round trip, plus NEAR_SLACK, are
+ * preferred, and among those only observers when there are any. The session is opened on the preferred
+ * servers alone. While it is watched over, a session unable to reach them for FAILOVER_MILLIS is handed
+ * the full list, and is moved back once a later probe finds the preferred servers reachable again.
+ */
+class ServerSelector {
+public:
+    static const unsigned int PROBE_TIMEOUT_MILLIS = 1000;
+    static const unsigned int PROBE_INTERVAL_SECONDS = 30;
+    static const unsigned int FAILOVER_MILLIS = 3000;
+    static const uint64_t NEAR_SLACK = 1000;
+
+    struct Server {
+        Server() :
+        reachable(false), observer(false), rtt(0) {
+
+        }
+
+        string address;
+        bool reachable;
+        bool observer;
+        // Microseconds taken to connect
+        uint64_t rtt;
+    };
+
+    ServerSelector(const string &hosts, Logger &logger);
+    virtual ~ServerSelector();
+
+    // Probes the servers, returning the host list to open the session with
+    string select();
+    // Watches over the session from a background thread until stop
+    void monitor(zhandle_t *handle);
+    void stop();
+
+    static Server probe(const string &address);
+
+private:
+    ServerSelector(const ServerSelector& orig);
+    ServerSelector& operator=(const ServerSelector &rhs);
+
+    vector<Server> probeAll() const;
+    string choose(const vector<Server> &servers) const;
+    string join(const vector<string> &addresses) const;
+    void setServers(const string &hosts, const char *reason);
+    void run();
+
+    vector<string> addresses_;
+    // Suffix of the host list naming the chroot, applied to every list handed to the client
+    string chroot_;
+    string all_;
+    Logger &logger_;
+
+    boost::mutex mutex_;
+    zhandle_t *handle_;
+    string preferred_;
+    string current_;
+    boost::thread thread_;
+};
+
+#endif /* SERVERSELECTOR_H */
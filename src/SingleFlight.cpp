@@ -0,0 +1,103 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   SingleFlight.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 9:30 AM
+ */
+
+#include "SingleFlight.h"
+
+SingleFlight::SingleFlight() :
+issued_(0), coalesced_(0) {
+
+}
+
+SingleFlight::~SingleFlight() {
+
+}
+
+string SingleFlight::makeKey(Operation operation, bool watched, const string &path) {
+    string retval;
+    retval.reserve(path.length() + 2);
+    retval.push_back('0' + operation);
+    retval.push_back(watched ? 'w' : '-');
+    retval += path;
+    return retval;
+}
+
+SingleFlight::Result SingleFlight::run(Operation operation, bool watched, const string &path, const Loader &loader) {
+    string key = makeKey(operation, watched, path);
+    boost::shared_ptr<Call> call;
+    boost::shared_ptr<const Result> shared;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        CallMap::iterator it = calls_.find(key);
+        if (it != calls_.end()) {
+            call = it->second;
+            coalesced_++;
+            while (!call->done) {
+                call->completed.wait(lock);
+            }
+            shared = call->result;
+        } else {
+            call.reset(new Call());
+            calls_[key] = call;
+            issued_++;
+        }
+    }
+    if (shared) {
+        return *shared;
+    }
+
+    boost::shared_ptr<Result> result(new Result());
+    try {
+        loader(*result);
+    } catch (...) {
+        // Waiters must always be released, loaders report failures through the result code
+        result->rc = ZSYSTEMERROR;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        call->result = result;
+        call->done = true;
+        CallMap::iterator it = calls_.find(key);
+        if (it != calls_.end() && it->second == call) {
+            calls_.erase(it);
+        }
+        call->completed.notify_all();
+    }
+    return *result;
+}
+
+void SingleFlight::forget(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    for (int operation = EXISTS; operation <= CHILDREN; operation++) {
+        calls_.erase(makeKey(static_cast<Operation>(operation), false, path));
+        calls_.erase(makeKey(static_cast<Operation>(operation), true, path));
+    }
+}
+
+uint64_t SingleFlight::getIssued() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return issued_;
+}
+
+uint64_t SingleFlight::getCoalesced() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return coalesced_;
+}
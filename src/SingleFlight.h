@@ -0,0 +1,105 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   SingleFlight.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 9:30 AM
+ */
+
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+/*
+ * Coalesces identical concurrent reads against the zoo.
+ *
+ * The first caller for a key performs the request, callers arriving while it is in flight wait for and
+ * share its result instead of sending their own. Nothing is cached once the request completes.
+ */
+class SingleFlight {
+public:
+    enum Operation {
+        EXISTS,
+        GET,
+        CHILDREN
+    };
+
+    struct Result {
+        Result() :
+        rc(ZOK), covered(true) {
+
+        }
+
+        int rc;
+        // False when the answer may predate the watch the read left, see HedgedReads
+        bool covered;
+        string data;
+        Stat stat;
+        vector<string> children;
+    };
+
+    typedef boost::function<void (Result&)> Loader;
+
+    SingleFlight();
+    virtual ~SingleFlight();
+
+    Result run(Operation operation, bool watched, const string &path, const Loader &loader);
+
+    // Detaches in flight reads of the path so callers arriving after a local write do not join them
+    void forget(const string &path);
+
+    uint64_t getIssued() const;
+    uint64_t getCoalesced() const;
+
+private:
+    SingleFlight(const SingleFlight& orig);
+    SingleFlight& operator=(const SingleFlight &rhs);
+
+    struct Call {
+        Call() :
+        done(false) {
+
+        }
+
+        bool done;
+        // Published once and never changed, so waiters copy it after releasing the lock
+        boost::shared_ptr<const Result> result;
+        boost::condition_variable completed;
+    };
+
+    typedef boost::unordered_map<string, boost::shared_ptr<Call> > CallMap;
+
+    static string makeKey(Operation operation, bool watched, const string &path);
+
+    mutable boost::mutex mutex_;
+    CallMap calls_;
+    uint64_t issued_;
+    uint64_t coalesced_;
+};
+
+#endif /* SINGLEFLIGHT_H */
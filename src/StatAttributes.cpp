@@ -0,0 +1,85 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   StatAttributes.cpp
+ * Author: kyle
+ *
+ * Created on October 20, 2026, 2:05 PM
+ */
+
+#include <stdint.h>
+#include <sstream>
+
+#include "StatAttributes.h"
+
+const char StatAttributes::PREFIX[] = "user.zk.";
+
+struct StatField {
+    const char *name;
+    int64_t (*value)(const Stat &stat);
+};
+
+static int64_t getCzxid(const Stat &stat) { return stat.czxid; }
+static int64_t getMzxid(const Stat &stat) { return stat.mzxid; }
+static int64_t getPzxid(const Stat &stat) { return stat.pzxid; }
+static int64_t getCtime(const Stat &stat) { return stat.ctime; }
+static int64_t getMtime(const Stat &stat) { return stat.mtime; }
+static int64_t getVersion(const Stat &stat) { return stat.version; }
+static int64_t getCversion(const Stat &stat) { return stat.cversion; }
+static int64_t getAversion(const Stat &stat) { return stat.aversion; }
+static int64_t getEphemeralOwner(const Stat &stat) { return stat.ephemeralOwner; }
+static int64_t getDataLength(const Stat &stat) { return stat.dataLength; }
+static int64_t getNumChildren(const Stat &stat) { return stat.numChildren; }
+
+static const StatField FIELDS[] = {
+    { "czxid", getCzxid },
+    { "mzxid", getMzxid },
+    { "pzxid", getPzxid },
+    { "ctime", getCtime },
+    { "mtime", getMtime },
+    { "version", getVersion },
+    { "cversion", getCversion },
+    { "aversion", getAversion },
+    { "ephemeralOwner", getEphemeralOwner },
+    { "dataLength", getDataLength },
+    { "numChildren", getNumChildren }
+};
+
+static const size_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+string StatAttributes::list() {
+    string retval;
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        retval += PREFIX;
+        retval += FIELDS[i].name;
+        retval += '\0';
+    }
+    return retval;
+}
+
+bool StatAttributes::get(const Stat &stat, const string &name, string &value) {
+    if (name.compare(0, sizeof(PREFIX) - 1, PREFIX) != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < FIELD_COUNT; i++) {
+        if (name.compare(sizeof(PREFIX) - 1, string::npos, FIELDS[i].name) == 0) {
+            ostringstream stream;
+            stream << FIELDS[i].value(stat);
+            value = stream.str();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   StatAttributes.h
+ * Author: kyle
+ *
+ * Created on October 20, 2026, 2:05 PM
+ */
+
+#ifndef STATATTRIBUTES_H
+#define STATATTRIBUTES_H
+
+#include <string>
+
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+/*
+ * Presents the fields of a node Stat as "user.zk.*" extended attributes, with signed decimal text values.
+ * Times are milliseconds since the epoch.
+ */
+class StatAttributes {
+public:
+    static const char PREFIX[];
+
+    // NUL terminated names one after the other, the way listxattr returns them
+    static string list();
+    // Returns false if the name is not one of the exposed attributes
+    static bool get(const Stat &stat, const string &name, string &value);
+};
+
+#endif /* STATATTRIBUTES_H */
@@ -0,0 +1,434 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   SubtreeArchive.cpp
+ * Author: kyle
+ *
+ * Created on October 21, 2026, 10:20 AM
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+
+#include <boost/thread/condition_variable.hpp>
+
+#include "SubtreeArchive.h"
+#include "ZooFile.h"
+#include "ZookeeperFuseContext.h"
+
+const size_t SubtreeArchive::WINDOW = 64;
+const int SubtreeArchive::MAX_ATTEMPTS = 3;
+const size_t SubtreeArchive::MAX_BATCH_OPS = 1000;
+
+static const char MAGIC[] = { 'Z', 'F', 'A', 1 };
+// Rough size of the framing of one operation within a multi request
+static const size_t OP_OVERHEAD = 64;
+
+struct SubtreeArchive::Traversal {
+    Traversal(const string &root) :
+    root(root), outstanding(0), rc(ZOK), changed(false) {
+
+    }
+
+    const string root;
+    boost::mutex mutex;
+    boost::condition_variable done;
+    deque<string> pending;
+    vector<Record> records;
+    size_t outstanding;
+    int rc;
+    bool changed;
+};
+
+struct SubtreeArchive::Request {
+    Traversal* traversal;
+    string path;
+};
+
+struct SubtreeArchive::Probe {
+    Probe(size_t count) :
+    exists(count, false), outstanding(0), rc(ZOK) {
+
+    }
+
+    boost::mutex mutex;
+    boost::condition_variable done;
+    vector<bool> exists;
+    size_t outstanding;
+    int rc;
+};
+
+struct SubtreeArchive::ProbeRequest {
+    Probe* probe;
+    size_t index;
+};
+
+static void putUint(string &out, uint32_t value) {
+    for (int i = 3; i >= 0; i--) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+static bool getUint(const string &in, size_t &offset, uint32_t &value) {
+    if (in.length() - offset < 4) {
+        return false;
+    }
+    const unsigned char *data = reinterpret_cast<const unsigned char*>(in.data() + offset);
+    value = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    offset += 4;
+    return true;
+}
+
+static bool isWithin(const string &path, const string &root) {
+    if (root == "/") {
+        return true;
+    }
+    return path.compare(0, root.length(), root) == 0 && (path.length() == root.length() || path[root.length()] == '/');
+}
+
+static string childOf(const string &parent, const string &relative) {
+    if (relative.empty()) {
+        return parent;
+    }
+    return parent == "/" ? parent + relative : parent + "/" + relative;
+}
+
+static string relativeTo(const string &path, const string &root) {
+    if (path.length() == root.length()) {
+        return "";
+    }
+    return path.substr(root == "/" ? 1 : root.length() + 1);
+}
+
+SubtreeArchive::SubtreeArchive(ZookeeperFuseContext* context) :
+context_(context) {
+
+}
+
+SubtreeArchive::~SubtreeArchive() {
+
+}
+
+void SubtreeArchive::watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx) {
+    SubtreeArchive* archive = reinterpret_cast<SubtreeArchive*>(watcherCtx);
+    if (type == ZOO_SESSION_EVENT) {
+        if (state == ZOO_EXPIRED_SESSION_STATE) {
+            archive->changed("");
+        }
+        return;
+    }
+    archive->changed(path);
+}
+
+// An empty path affects every walk
+void SubtreeArchive::changed(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    // Watches outlive their walk, events without a matching walk in progress are simply dropped
+    for (list<Traversal*>::iterator it = active_.begin(); it != active_.end(); ++it) {
+        if (path.empty() || isWithin(path, (*it)->root)) {
+            boost::lock_guard<boost::mutex> traversalLock((*it)->mutex);
+            (*it)->changed = true;
+        }
+    }
+}
+
+void SubtreeArchive::dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    Request* request = const_cast<Request*>(reinterpret_cast<const Request*>(data));
+    Traversal* traversal = request->traversal;
+
+    {
+        boost::lock_guard<boost::mutex> lock(traversal->mutex);
+        if (rc == ZOK) {
+            // Ephemeral nodes belong to a session, they would be meaningless once restored
+            if (stat->ephemeralOwner == 0) {
+                Record record;
+                record.path = relativeTo(request->path, traversal->root);
+                record.data.assign(value != NULL ? value : "", valueLength > 0 ? valueLength : 0);
+                traversal->records.push_back(record);
+            }
+        } else if (rc == ZNONODE && request->path != traversal->root) {
+            traversal->changed = true;
+        } else if (traversal->rc == ZOK) {
+            traversal->rc = rc;
+        }
+        traversal->outstanding--;
+        traversal->done.notify_all();
+    }
+    delete request;
+}
+
+void SubtreeArchive::childrenCompletion(int rc, const struct String_vector *strings, const void *data) {
+    Request* request = const_cast<Request*>(reinterpret_cast<const Request*>(data));
+    Traversal* traversal = request->traversal;
+
+    {
+        boost::lock_guard<boost::mutex> lock(traversal->mutex);
+        if (rc == ZOK) {
+            for (int i = 0; strings != NULL && i < strings->count; i++) {
+                traversal->pending.push_back(childOf(request->path, strings->data[i]));
+            }
+        } else if (rc == ZNONODE && request->path != traversal->root) {
+            traversal->changed = true;
+        } else if (traversal->rc == ZOK) {
+            traversal->rc = rc;
+        }
+        traversal->outstanding--;
+        traversal->done.notify_all();
+    }
+    delete request;
+}
+
+void SubtreeArchive::existsCompletion(int rc, const struct Stat *stat, const void *data) {
+    ProbeRequest* request = const_cast<ProbeRequest*>(reinterpret_cast<const ProbeRequest*>(data));
+    Probe* probe = request->probe;
+
+    {
+        boost::lock_guard<boost::mutex> lock(probe->mutex);
+        if (rc == ZOK) {
+            probe->exists[request->index] = true;
+        } else if (rc != ZNONODE && probe->rc == ZOK) {
+            probe->rc = rc;
+        }
+        probe->outstanding--;
+        probe->done.notify_all();
+    }
+    delete request;
+}
+
+bool SubtreeArchive::traverse(zhandle_t *handle, const string &zooPath, vector<Record> &records) {
+    Traversal traversal(zooPath);
+    traversal.pending.push_back(zooPath);
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        active_.push_back(&traversal);
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(traversal.mutex);
+        // Stop issuing on the first error or change, but always wait for what is in flight
+        while (traversal.outstanding > 0 ||
+               (!traversal.pending.empty() && traversal.rc == ZOK && !traversal.changed)) {
+            while (!traversal.pending.empty() && traversal.outstanding + 2 <= WINDOW &&
+                   traversal.rc == ZOK && !traversal.changed) {
+                string path = traversal.pending.front();
+                traversal.pending.pop_front();
+
+                Request* request = new Request();
+                request->traversal = &traversal;
+                request->path = path;
+                int rc = zoo_awget(handle, path.c_str(), watcher, this, dataCompletion, request);
+                if (rc != ZOK) {
+                    delete request;
+                    traversal.rc = rc;
+                    break;
+                }
+                traversal.outstanding++;
+
+                request = new Request();
+                request->traversal = &traversal;
+                request->path = path;
+                rc = zoo_awget_children(handle, path.c_str(), watcher, this, childrenCompletion, request);
+                if (rc != ZOK) {
+                    delete request;
+                    traversal.rc = rc;
+                    break;
+                }
+                traversal.outstanding++;
+            }
+            if (traversal.outstanding > 0) {
+                traversal.done.wait(lock);
+            }
+        }
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        active_.remove(&traversal);
+    }
+
+    if (traversal.rc != ZOK) {
+        throw ZooFileException("An error occurred exporting the subtree of: " + zooPath, traversal.rc);
+    }
+    records.swap(traversal.records);
+    return !traversal.changed;
+}
+
+string SubtreeArchive::exportTree(const string &zooPath) {
+    zhandle_t* handle = context_->getZookeeperHandle();
+    if (handle == NULL) {
+        throw ZooFileException("No zookeeper connection to export: " + zooPath, ZINVALIDSTATE);
+    }
+
+    vector<Record> records;
+    for (int attempt = 1; attempt <= MAX_ATTEMPTS; attempt++) {
+        if (traverse(handle, zooPath, records)) {
+            break;
+        }
+        if (attempt == MAX_ATTEMPTS) {
+            context_->getLogger().log(Logger::WARNING, "Subtree %s kept changing, the export may not be consistent", zooPath.c_str());
+        }
+    }
+    std::sort(records.begin(), records.end());
+    return encode(records);
+}
+
+void SubtreeArchive::createOrSet(zhandle_t *handle, const string &path, const string &data) {
+    int rc = zoo_create(handle, path.c_str(), data.data(), data.length(), &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+    if (rc == ZNODEEXISTS) {
+        rc = zoo_set(handle, path.c_str(), data.data(), data.length(), -1);
+    }
+    if (rc != ZOK) {
+        throw ZooFileException("An error occurred importing node: " + path, rc);
+    }
+    ZooFile::forgetWritten(context_->getFileOptions(), path);
+}
+
+// Finds which of the nodes from first to last already exist, with all the requests in flight at once
+void SubtreeArchive::probeExisting(zhandle_t *handle, const vector<string> &paths, size_t first, size_t last, vector<bool> &exists) {
+    Probe probe(last - first);
+    {
+        boost::unique_lock<boost::mutex> lock(probe.mutex);
+        for (size_t i = first; i < last && probe.rc == ZOK; i++) {
+            ProbeRequest* request = new ProbeRequest();
+            request->probe = &probe;
+            request->index = i - first;
+            int rc = zoo_aexists(handle, paths[i].c_str(), 0, existsCompletion, request);
+            if (rc != ZOK) {
+                delete request;
+                probe.rc = rc;
+                break;
+            }
+            probe.outstanding++;
+        }
+        while (probe.outstanding > 0) {
+            probe.done.wait(lock);
+        }
+    }
+
+    if (probe.rc != ZOK) {
+        throw ZooFileException("An error occurred checking the nodes to import below: " + paths[first], probe.rc);
+    }
+    exists.swap(probe.exists);
+}
+
+size_t SubtreeArchive::importTree(const string &zooPath, const string &archive) {
+    vector<Record> records = decode(archive);
+    // Parents have to be created before their children
+    std::sort(records.begin(), records.end());
+    if (records.empty() || !records[0].path.empty()) {
+        throw ZooFileException("The archive has no root node to import at: " + zooPath, ZBADARGUMENTS);
+    }
+
+    zhandle_t* handle = context_->getZookeeperHandle();
+    if (handle == NULL) {
+        throw ZooFileException("No zookeeper connection to import: " + zooPath, ZINVALIDSTATE);
+    }
+    const ZooFileOptions &options = context_->getFileOptions();
+    // Deferred writes would land after the import and overwrite it
+    if (options.writeBehind) {
+        options.writeBehind->discardTree(zooPath);
+    }
+    createOrSet(handle, zooPath, records[0].data);
+
+    vector<string> paths;
+    paths.reserve(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        paths.push_back(childOf(zooPath, records[i].path));
+    }
+
+    // Set once a batch ran into existing nodes, the following ones are then checked before they are sent
+    bool existing = false;
+    size_t first = 1;
+    while (first < records.size()) {
+        size_t last = first;
+        size_t bytes = 0;
+        while (last < records.size() && last - first < MAX_BATCH_OPS &&
+               (last == first || bytes + records[last].data.length() + paths[last].length() + OP_OVERHEAD <= ZooFile::MAX_TRANSACTION_SIZE)) {
+            bytes += records[last].data.length() + paths[last].length() + OP_OVERHEAD;
+            last++;
+        }
+
+        vector<zoo_op_t> ops(last - first);
+        vector<zoo_op_result_t> results(last - first);
+        vector<bool> exists(last - first, false);
+        for (int attempt = 1; ; attempt++) {
+            if (existing) {
+                probeExisting(handle, paths, first, last, exists);
+            }
+            for (size_t i = first; i < last; i++) {
+                if (exists[i - first]) {
+                    zoo_set_op_init(&ops[i - first], paths[i].c_str(), records[i].data.data(), records[i].data.length(), -1, NULL);
+                } else {
+                    zoo_create_op_init(&ops[i - first], paths[i].c_str(), records[i].data.data(), records[i].data.length(),
+                                       &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+                }
+            }
+            int rc = zoo_multi(handle, ops.size(), &ops[0], &results[0]);
+            if (rc == ZOK) {
+                break;
+            }
+            // Nodes which already exist fail the whole transaction, it is sent again with sets for those. A node
+            // created or removed by someone else in between fails it once more
+            if ((rc != ZNODEEXISTS && rc != ZNONODE) || attempt == MAX_ATTEMPTS) {
+                throw ZooFileException("An error occurred importing the nodes below: " + paths[first], rc);
+            }
+            existing = true;
+        }
+        for (size_t i = first; i < last; i++) {
+            ZooFile::forgetWritten(options, paths[i]);
+        }
+        first = last;
+    }
+    return records.size();
+}
+
+string SubtreeArchive::encode(const vector<Record> &records) {
+    string retval(MAGIC, sizeof(MAGIC));
+    for (size_t i = 0; i < records.size(); i++) {
+        putUint(retval, records[i].path.length());
+        retval += records[i].path;
+        putUint(retval, records[i].data.length());
+        retval += records[i].data;
+    }
+    return retval;
+}
+
+vector<SubtreeArchive::Record> SubtreeArchive::decode(const string &archive) {
+    if (archive.length() < sizeof(MAGIC) || memcmp(archive.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        throw ZooFileException("Not a subtree archive", ZBADARGUMENTS);
+    }
+
+    vector<Record> retval;
+    size_t offset = sizeof(MAGIC);
+    while (offset < archive.length()) {
+        uint32_t pathLength;
+        uint32_t dataLength;
+        Record record;
+        if (!getUint(archive, offset, pathLength) || archive.length() - offset < pathLength) {
+            throw ZooFileException("Truncated subtree archive", ZBADARGUMENTS);
+        }
+        record.path = archive.substr(offset, pathLength);
+        offset += pathLength;
+        if (!getUint(archive, offset, dataLength) || archive.length() - offset < dataLength) {
+            throw ZooFileException("Truncated subtree archive", ZBADARGUMENTS);
+        }
+        record.data = archive.substr(offset, dataLength);
+        offset += dataLength;
+        retval.push_back(record);
+    }
+    return retval;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   SubtreeArchive.h
+ * Author: kyle
+ *
+ * Created on October 21, 2026, 10:20 AM
+ */
+
+#ifndef SUBTREEARCHIVE_H
+#define SUBTREEARCHIVE_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+class ZookeeperFuseContext;
+
+/*
+ * Copies whole subtrees in and out of the zoo as a single binary archive.
+ *
+ * Exports walk the subtree with up to WINDOW asynchronous requests in flight, leaving a watch on every node
+ * read. If none fired by the end of the walk, every node held the archived state at that moment, otherwise
+ * the walk is repeated. Imports create the nodes with batched multi transactions, after dropping deferred
+ * writes within the subtree, and make local reads forget what they knew of every imported node.
+ *
+ * Archives hold the stored payloads, so compressed contents and chunked files are copied as they are.
+ * Ephemeral nodes are left out. Errors are thrown as ZooFileException.
+ */
+class SubtreeArchive {
+public:
+    static const size_t WINDOW;
+    static const int MAX_ATTEMPTS;
+    static const size_t MAX_BATCH_OPS;
+
+    SubtreeArchive(ZookeeperFuseContext* context);
+    virtual ~SubtreeArchive();
+
+    string exportTree(const string &zooPath);
+    // Recreates the archived nodes at zooPath, nodes which already exist have their contents replaced
+    size_t importTree(const string &zooPath, const string &archive);
+
+    static void watcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx);
+
+private:
+    SubtreeArchive(const SubtreeArchive& orig);
+    SubtreeArchive& operator=(const SubtreeArchive &rhs);
+
+    struct Record {
+        // Relative to the root of the archive, empty for the root itself
+        string path;
+        string data;
+
+        bool operator<(const Record &rhs) const {
+            return path < rhs.path;
+        }
+    };
+
+    struct Traversal;
+    struct Request;
+    struct Probe;
+    struct ProbeRequest;
+
+    bool traverse(zhandle_t *handle, const string &zooPath, vector<Record> &records);
+    void changed(const string &path);
+    void createOrSet(zhandle_t *handle, const string &path, const string &data);
+    void probeExisting(zhandle_t *handle, const vector<string> &paths, size_t first, size_t last, vector<bool> &exists);
+
+    static string encode(const vector<Record> &records);
+    static vector<Record> decode(const string &archive);
+
+    static void dataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data);
+    static void childrenCompletion(int rc, const struct String_vector *strings, const void *data);
+    static void existsCompletion(int rc, const struct Stat *stat, const void *data);
+
+    ZookeeperFuseContext* context_;
+    boost::mutex mutex_;
+    list<Traversal*> active_;
+};
+
+#endif /* SUBTREEARCHIVE_H */
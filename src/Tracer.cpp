@@ -0,0 +1,207 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Tracer.cpp
+ * Author: kyle
+ *
+ * Created on October 21, 2026, 4:45 PM
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "Tracer.h"
+
+const size_t Tracer::DEFAULT_WINDOW = 100000;
+
+volatile sig_atomic_t Tracer::writeRequested_ = 0;
+
+static void writeEscaped(FILE *out, const char *text) {
+    for (const char *it = text; *it != '\0'; it++) {
+        unsigned char c = *it;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+}
+
+Tracer::Tracer(const string &file, unsigned int sampleRate, size_t windowSize) :
+file_(file),
+sampleRate_(sampleRate > 0 ? sampleRate : 1),
+windowSize_(windowSize > 0 ? windowSize : 1),
+epoch_(now()),
+state_(keepState),
+dropped_(0),
+stopping_(false) {
+
+}
+
+Tracer::~Tracer() {
+    stopping_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    write();
+    for (size_t i = 0; i < states_.size(); i++) {
+        delete states_[i];
+    }
+}
+
+// States stay with the tracer after their thread exits, their ring may still hold spans
+void Tracer::keepState(ThreadState *state) {
+
+}
+
+uint64_t Tracer::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+Tracer::ThreadState* Tracer::getState() {
+    ThreadState* retval = state_.get();
+    if (retval == NULL) {
+        retval = new ThreadState(syscall(SYS_gettid));
+        state_.reset(retval);
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        states_.push_back(retval);
+        // Started by the first traced thread rather than in main, where fuse would lose it when daemonizing
+        if (!thread_.joinable()) {
+            thread_ = boost::thread(boost::bind(&Tracer::run, this));
+        }
+    }
+    return retval;
+}
+
+uint64_t Tracer::begin(bool root) {
+    ThreadState* state = getState();
+    if (root) {
+        state->active = true;
+        state->sampled = state->counter++ % sampleRate_ == 0;
+    } else if (!state->active) {
+        return 0;
+    }
+    // Offset by one so that a span starting at the epoch is not mistaken for an unrecorded one
+    return state->sampled ? now() - epoch_ + 1 : 0;
+}
+
+void Tracer::push(ThreadState *state, const char *name, const char *path, uint64_t start, uint64_t id) {
+    Event event;
+    event.name = name;
+    strncpy(event.path, path != NULL ? path : "", PATH_SIZE - 1);
+    event.path[PATH_SIZE - 1] = '\0';
+    event.start = start - 1;
+    event.duration = now() - epoch_ + 1 - start;
+    event.thread = state->thread;
+    event.id = id;
+    if (!state->events.push(event)) {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        dropped_++;
+    }
+}
+
+void Tracer::end(const char *name, const char *path, uint64_t start, bool root) {
+    ThreadState* state = getState();
+    if (start != 0) {
+        push(state, name, path, start, 0);
+    }
+    if (root) {
+        state->active = false;
+    }
+}
+
+void Tracer::record(const char *name, const char *path, uint64_t start) {
+    if (start != 0) {
+        ThreadState* state = getState();
+        push(state, name, path, start, (static_cast<uint64_t>(state->thread) << 32) | ++state->asyncCounter);
+    }
+}
+
+void Tracer::drain() {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    Event event;
+    for (size_t i = 0; i < states_.size(); i++) {
+        while (states_[i]->events.pop(event)) {
+            if (window_.size() == windowSize_) {
+                window_.pop_front();
+            }
+            window_.push_back(event);
+        }
+    }
+}
+
+void Tracer::run() {
+    while (!stopping_) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        drain();
+        if (writeRequested_) {
+            writeRequested_ = 0;
+            write();
+        }
+    }
+}
+
+void Tracer::write() {
+    drain();
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    // Written next to the target and moved over it, so readers never see a partial trace
+    string temporary = file_ + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "w");
+    if (out == NULL) {
+        return;
+    }
+    fprintf(out, "{\"traceEvents\":[\n");
+    int pid = getpid();
+    for (size_t i = 0; i < window_.size(); i++) {
+        const Event &event = window_[i];
+        if (event.id == 0) {
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%u,\"args\":{\"path\":\"",
+                    i == 0 ? "" : ",\n", event.name, (unsigned long long) event.start, (unsigned long long) event.duration,
+                    pid, event.thread);
+            writeEscaped(out, event.path);
+            fprintf(out, "\"}}");
+            continue;
+        }
+        // Async spans overlap freely, they are drawn on their own tracks as begin and end pairs
+        fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%llu,\"pid\":%d,\"tid\":%u,\"args\":{\"path\":\"",
+                i == 0 ? "" : ",\n", event.name, (unsigned long long) event.id, (unsigned long long) event.start, pid, event.thread);
+        writeEscaped(out, event.path);
+        fprintf(out, "\"}},\n{\"name\":\"%s\",\"cat\":\"async\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%llu,\"pid\":%d,\"tid\":%u}",
+                event.name, (unsigned long long) event.id, (unsigned long long) (event.start + event.duration), pid, event.thread);
+    }
+    fprintf(out, "\n],\"otherData\":{\"dropped\":%llu}}\n", (unsigned long long) dropped_);
+    fclose(out);
+    rename(temporary.c_str(), file_.c_str());
+}
+
+void Tracer::requestWrite(int signal) {
+    writeRequested_ = 1;
+}
+
+uint64_t Tracer::getDropped() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return dropped_;
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Tracer.h
+ * Author: kyle
+ *
+ * Created on October 21, 2026, 4:45 PM
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+using namespace std;
+
+/*
+ * Records spans of fuse callbacks and of the zookeeper calls made on their behalf, in the Chrome trace
+ * event format understood by chrome://tracing and Perfetto.
+ *
+ * Every thread appends finished spans to its own lock-free ring, a background thread moves them into a
+ * window of the last windowSize spans, about 140 bytes each. The window is written out on SIGUSR2 and when
+ * the tracer is destroyed. Only one in sampleRate callbacks is traced, spans outside a traced callback are
+ * skipped.
+ */
+class Tracer {
+public:
+    static const size_t THREAD_BUFFER_SIZE = 4096;
+    static const size_t DEFAULT_WINDOW;
+    static const size_t PATH_SIZE = 96;
+
+    Tracer(const string &file, unsigned int sampleRate, size_t windowSize = DEFAULT_WINDOW);
+    virtual ~Tracer();
+
+    // Returns the start of a span, 0 if it is not recorded
+    uint64_t begin(bool root);
+    void end(const char *name, const char *path, uint64_t start, bool root);
+    // Finishes a span started by begin on another thread, it is shown as an async span
+    void record(const char *name, const char *path, uint64_t start);
+
+    void write();
+    // Async signal safe, the write happens on the tracer thread
+    static void requestWrite(int signal);
+
+    uint64_t getDropped() const;
+
+private:
+    Tracer(const Tracer& orig);
+    Tracer& operator=(const Tracer &rhs);
+
+    struct Event {
+        const char *name;
+        char path[PATH_SIZE];
+        uint64_t start;
+        uint64_t duration;
+        uint32_t thread;
+        // Non zero for async spans
+        uint64_t id;
+    };
+
+    struct ThreadState {
+        ThreadState(uint32_t thread) :
+        events(THREAD_BUFFER_SIZE), thread(thread), counter(0), asyncCounter(0), active(false), sampled(false) {
+
+        }
+
+        boost::lockfree::spsc_queue<Event> events;
+        uint32_t thread;
+        uint32_t counter;
+        uint32_t asyncCounter;
+        bool active;
+        bool sampled;
+    };
+
+    static void keepState(ThreadState *state);
+    static uint64_t now();
+
+    ThreadState* getState();
+    void push(ThreadState *state, const char *name, const char *path, uint64_t start, uint64_t id);
+    void drain();
+    void run();
+
+    const string file_;
+    const unsigned int sampleRate_;
+    const size_t windowSize_;
+    const uint64_t epoch_;
+    boost::thread_specific_ptr<ThreadState> state_;
+    mutable boost::mutex mutex_;
+    vector<ThreadState*> states_;
+    deque<Event> window_;
+    uint64_t dropped_;
+    volatile bool stopping_;
+    boost::thread thread_;
+
+    static volatile sig_atomic_t writeRequested_;
+};
+
+/*
+ * Scoped span, does nothing when there is no tracer
+ */
+class TraceSpan {
+public:
+    TraceSpan(Tracer *tracer, const char *name, const char *path, bool root = false) :
+    tracer_(tracer), name_(name), path_(path), root_(root), start_(tracer ? tracer->begin(root) : 0) {
+
+    }
+
+    ~TraceSpan() {
+        if (tracer_) {
+            tracer_->end(name_, path_, start_, root_);
+        }
+    }
+
+private:
+    TraceSpan(const TraceSpan& orig);
+    TraceSpan& operator=(const TraceSpan &rhs);
+
+    Tracer *tracer_;
+    const char *name_;
+    const char *path_;
+    bool root_;
+    uint64_t start_;
+};
+
+#endif /* TRACER_H */
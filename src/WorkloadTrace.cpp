@@ -0,0 +1,200 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   WorkloadTrace.cpp
+ * Author: kyle
+ *
+ * Created on October 22, 2026, 9:10 AM
+ */
+
+#include <time.h>
+#include <boost/thread/lock_guard.hpp>
+
+#include "WorkloadTrace.h"
+
+static const char MAGIC[] = { 'Z', 'F', 'W', 1 };
+
+static const char* OP_NAMES[] = {
+    "getattr", "readdir", "open", "read", "write", "chmod", "chown", "utime", "create", "truncate", "unlink",
+    "mkdir", "fsync", "getxattr", "listxattr", "flush", "release"
+};
+
+static void putVarint(string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static bool getVarint(const string &in, size_t &position, uint64_t &value) {
+    value = 0;
+    for (unsigned int shift = 0; position < in.length() && shift < 64; shift += 7) {
+        unsigned char byte = in[position++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* WorkloadRecord::opToString(WorkloadOp op) {
+    return op < OP_COUNT ? OP_NAMES[op] : "unknown";
+}
+
+WorkloadRecorder::WorkloadRecorder(const string &file) :
+out_(fopen(file.c_str(), "wb")),
+epoch_(now()),
+lastStart_(0),
+count_(0) {
+    if (out_ == NULL) {
+        throw WorkloadTraceException("Could not create workload capture: " + file);
+    }
+    buffer_.reserve(FLUSH_SIZE);
+    buffer_.append(MAGIC, sizeof (MAGIC));
+    // The empty string is always defined, records without a name refer to it
+    strings_[""] = 0;
+}
+
+WorkloadRecorder::~WorkloadRecorder() {
+    flush();
+    fclose(out_);
+}
+
+uint64_t WorkloadRecorder::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+void WorkloadRecorder::writeString(const char *value) {
+    string key(value != NULL ? value : "");
+    boost::unordered_map<string, uint64_t>::iterator it = strings_.find(key);
+    if (it != strings_.end()) {
+        putVarint(buffer_, it->second);
+        return;
+    }
+    uint64_t index = strings_.size();
+    strings_[key] = index;
+    putVarint(buffer_, index);
+    putVarint(buffer_, key.length());
+    buffer_.append(key);
+}
+
+void WorkloadRecorder::record(WorkloadOp op, const char *path, uint64_t offset, uint64_t size, uint64_t start,
+                              const char *name) {
+    uint64_t end = now();
+    start -= epoch_;
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    map<boost::thread::id, uint32_t>::iterator thread = threads_.find(boost::this_thread::get_id());
+    if (thread == threads_.end()) {
+        thread = threads_.insert(make_pair(boost::this_thread::get_id(), (uint32_t) threads_.size())).first;
+    }
+
+    // Records are appended as their callbacks return, so starts are not ordered
+    int64_t delta = static_cast<int64_t>(start - lastStart_);
+    lastStart_ = start;
+
+    buffer_.push_back(static_cast<char>(op));
+    putVarint(buffer_, thread->second);
+    putVarint(buffer_, (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+    putVarint(buffer_, end - epoch_ - start);
+    putVarint(buffer_, offset);
+    putVarint(buffer_, size);
+    writeString(path);
+    writeString(name);
+    count_++;
+
+    if (buffer_.length() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void WorkloadRecorder::flush() {
+    if (!buffer_.empty()) {
+        fwrite(buffer_.data(), 1, buffer_.length(), out_);
+        fflush(out_);
+        buffer_.clear();
+    }
+}
+
+uint64_t WorkloadRecorder::getCount() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return count_;
+}
+
+vector<WorkloadRecord> WorkloadReader::read(const string &file) {
+    FILE *in = fopen(file.c_str(), "rb");
+    if (in == NULL) {
+        throw WorkloadTraceException("Could not open workload capture: " + file);
+    }
+    string content;
+    char block[65536];
+    size_t length;
+    while ((length = fread(block, 1, sizeof (block), in)) > 0) {
+        content.append(block, length);
+    }
+    fclose(in);
+
+    if (content.compare(0, sizeof (MAGIC), string(MAGIC, sizeof (MAGIC))) != 0) {
+        throw WorkloadTraceException("Not a workload capture: " + file);
+    }
+
+    vector<WorkloadRecord> retval;
+    vector<string> strings(1, "");
+    uint64_t start = 0;
+    size_t position = sizeof (MAGIC);
+    while (position < content.length()) {
+        WorkloadRecord record;
+        unsigned char op = content[position++];
+        uint64_t thread, delta, index[2];
+        if (op >= OP_COUNT) {
+            throw WorkloadTraceException("Corrupt workload capture: " + file);
+        }
+        if (!getVarint(content, position, thread) || !getVarint(content, position, delta) ||
+            !getVarint(content, position, record.duration) || !getVarint(content, position, record.offset) ||
+            !getVarint(content, position, record.size)) {
+            break;
+        }
+        bool complete = true;
+        for (int i = 0; i < 2 && complete; i++) {
+            complete = getVarint(content, position, index[i]);
+            if (complete && index[i] == strings.size()) {
+                uint64_t stringLength;
+                complete = getVarint(content, position, stringLength) && content.length() - position >= stringLength;
+                if (complete) {
+                    strings.push_back(content.substr(position, stringLength));
+                    position += stringLength;
+                }
+            } else if (complete && index[i] > strings.size()) {
+                throw WorkloadTraceException("Corrupt workload capture: " + file);
+            }
+        }
+        if (!complete) {
+            break;
+        }
+
+        start += static_cast<int64_t>((delta >> 1) ^ (~(delta & 1) + 1));
+        record.op = static_cast<WorkloadOp>(op);
+        record.thread = thread;
+        record.start = start;
+        record.path = strings[index[0]];
+        record.name = strings[index[1]];
+        retval.push_back(record);
+    }
+    return retval;
+}
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   WorkloadTrace.h
+ * Author: kyle
+ *
+ * Created on October 22, 2026, 9:10 AM
+ */
+
+#ifndef WORKLOADTRACE_H
+#define WORKLOADTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <exception>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+using namespace std;
+
+class WorkloadTraceException : public std::exception {
+public:
+    WorkloadTraceException(string msg) :
+    msg_(msg) {
+
+    }
+
+    virtual ~WorkloadTraceException() throw() {
+
+    }
+
+    virtual const char* what() const throw()
+    {
+      return msg_.c_str();
+    }
+
+private:
+    string msg_;
+};
+
+/*
+ * Fuse operations captured by --record, in the order of the fuse_operations members they are recorded from
+ */
+enum WorkloadOp {
+    OP_GETATTR,
+    OP_READDIR,
+    OP_OPEN,
+    OP_READ,
+    OP_WRITE,
+    OP_CHMOD,
+    OP_CHOWN,
+    OP_UTIME,
+    OP_CREATE,
+    OP_TRUNCATE,
+    OP_UNLINK,
+    OP_MKDIR,
+    OP_FSYNC,
+    OP_GETXATTR,
+    OP_LISTXATTR,
+    OP_FLUSH,
+    OP_RELEASE,
+    OP_COUNT
+};
+
+/*
+ * A single captured operation. Times are in microseconds, start is relative to the start of the capture.
+ * Offset and size carry the operation's numeric arguments: the offset and size of reads and writes, the
+ * length of truncates, the open flags in size, the mode of creates, mkdirs and chmods in size, the owner of
+ * chowns in offset and size.
+ */
+struct WorkloadRecord {
+    WorkloadOp op;
+    uint32_t thread;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t offset;
+    uint64_t size;
+    string path;
+    // Attribute name of getxattr, empty otherwise
+    string name;
+
+    static const char* opToString(WorkloadOp op);
+};
+
+/*
+ * Appends records to a compact binary file.
+ *
+ * The file starts with a magic, each record is an op byte followed by varints: the recording thread, the
+ * zigzag encoded difference between its start and the previous record's start, the duration, offset and
+ * size, then references to the path and name. Strings are interned, a reference to the next unused index
+ * is followed by the string itself and defines it. Records are buffered and appended in FLUSH_SIZE blocks,
+ * a capture cut short by a crash is still readable up to its last block.
+ */
+class WorkloadRecorder {
+public:
+    static const size_t FLUSH_SIZE = 65536;
+
+    // Throws if file can not be created
+    WorkloadRecorder(const string &file);
+    virtual ~WorkloadRecorder();
+
+    void record(WorkloadOp op, const char *path, uint64_t offset, uint64_t size, uint64_t start, const char *name = NULL);
+
+    uint64_t getCount() const;
+
+    static uint64_t now();
+
+private:
+    WorkloadRecorder(const WorkloadRecorder& orig);
+    WorkloadRecorder& operator=(const WorkloadRecorder &rhs);
+
+    void writeString(const char *value);
+    void flush();
+
+    FILE *out_;
+    const uint64_t epoch_;
+    mutable boost::mutex mutex_;
+    string buffer_;
+    boost::unordered_map<string, uint64_t> strings_;
+    map<boost::thread::id, uint32_t> threads_;
+    uint64_t lastStart_;
+    uint64_t count_;
+};
+
+/*
+ * Reads back the records of a file written by WorkloadRecorder
+ */
+class WorkloadReader {
+public:
+    // Throws if file can not be read or is not a capture, a truncated last record is ignored
+    static vector<WorkloadRecord> read(const string &file);
+};
+
+/*
+ * Records a callback from construction until it returns, does nothing when there is no recorder
+ */
+class RecordedOp {
+public:
+    RecordedOp(WorkloadRecorder *recorder, WorkloadOp op, const char *path, uint64_t offset = 0, uint64_t size = 0,
+               const char *name = NULL) :
+    recorder_(recorder), op_(op), path_(path), offset_(offset), size_(size), name_(name),
+    start_(recorder ? WorkloadRecorder::now() : 0) {
+
+    }
+
+    ~RecordedOp() {
+        if (recorder_) {
+            recorder_->record(op_, path_, offset_, size_, start_, name_);
+        }
+    }
+
+private:
+    RecordedOp(const RecordedOp& orig);
+    RecordedOp& operator=(const RecordedOp &rhs);
+
+    WorkloadRecorder *recorder_;
+    WorkloadOp op_;
+    const char *path_;
+    uint64_t offset_;
+    uint64_t size_;
+    const char *name_;
+    uint64_t start_;
+};
+
+#endif /* WORKLOADTRACE_H */
@@ -0,0 +1,293 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   WriteBehindQueue.cpp
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 11:45 AM
+ */
+
+#include <boost/bind.hpp>
+
+#include "WriteBehindQueue.h"
+#include "ZookeeperFuseContext.h"
+#include "ZooFile.h"
+
+using namespace boost::posix_time;
+
+WriteBehindQueue::WriteBehindQueue(ZookeeperFuseContext* context, unsigned int windowMillis) :
+context_(context), window_(milliseconds(windowMillis)), writes_(0), flushes_(0), stopping_(false) {
+
+}
+
+WriteBehindQueue::~WriteBehindQueue() {
+    {
+        boost::lock_guard<boost::mutex> lock(mutex_);
+        stopping_ = true;
+        changed_.notify_all();
+    }
+    if (flusher_) {
+        flusher_->join();
+    }
+    flushAll();
+}
+
+void WriteBehindQueue::put(const string &path, const string &content, bool plain) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    writes_++;
+    // Started by the first write rather than in main, where fuse would lose it when daemonizing
+    if (!flusher_) {
+        flusher_.reset(new boost::thread(boost::bind(&WriteBehindQueue::run, this)));
+    }
+
+    boost::shared_ptr<Entry>& entry = pending_[path];
+    if (!entry) {
+        entry.reset(new Entry());
+        entry->deadline = microsec_clock::universal_time() + window_;
+        entry->plain = plain;
+        changed_.notify_all();
+    }
+    entry->content = content;
+    // Later writes read the pending content and no longer learn the layout, keep what the first one found
+    entry->plain = entry->plain || plain;
+}
+
+bool WriteBehindQueue::get(const string &path, string &content) const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+
+    EntryMap::const_iterator it = pending_.find(path);
+    if (it == pending_.end()) {
+        it = flushing_.find(path);
+        if (it == flushing_.end()) {
+            return false;
+        }
+    }
+    content = it->second->content;
+    return true;
+}
+
+bool WriteBehindQueue::contains(const string &path) const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return pending_.find(path) != pending_.end() || flushing_.find(path) != flushing_.end();
+}
+
+void WriteBehindQueue::discard(const string &path) {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    pending_.erase(path);
+    errors_.erase(path);
+}
+
+static bool isWithin(const string &path, const string &root) {
+    if (root == "/") {
+        return true;
+    }
+    return path.compare(0, root.length(), root) == 0 && (path.length() == root.length() || path[root.length()] == '/');
+}
+
+void WriteBehindQueue::discardTree(const string &root) {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    for (EntryMap::iterator it = pending_.begin(); it != pending_.end();) {
+        if (isWithin(it->first, root)) {
+            errors_.erase(it->first);
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (EntryMap::iterator it = flushing_.begin(); it != flushing_.end();) {
+        if (isWithin(it->first, root)) {
+            changed_.wait(lock);
+            it = flushing_.begin();
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WriteBehindQueue::takeDue(bool all, vector<string> &paths, vector<boost::shared_ptr<Entry> > &entries) {
+    ptime now = microsec_clock::universal_time();
+    for (EntryMap::iterator it = pending_.begin(); it != pending_.end();) {
+        // A node still being written by another flush has to wait, or the older content could land last
+        if ((all || it->second->deadline <= now) && flushing_.find(it->first) == flushing_.end()) {
+            paths.push_back(it->first);
+            entries.push_back(it->second);
+            flushing_[it->first] = it->second;
+            it = pending_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void WriteBehindQueue::run() {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (!stopping_) {
+        vector<string> paths;
+        vector<boost::shared_ptr<Entry> > entries;
+        takeDue(false, paths, entries);
+
+        if (!entries.empty()) {
+            lock.unlock();
+            write(paths, entries);
+            lock.lock();
+            continue;
+        }
+
+        ptime next = microsec_clock::universal_time() + window_;
+        for (EntryMap::const_iterator it = pending_.begin(); it != pending_.end(); ++it) {
+            next = std::min(next, it->second->deadline);
+        }
+        changed_.timed_wait(lock, next);
+    }
+}
+
+int WriteBehindQueue::writeOne(const string &path, const Entry &entry) {
+    ZooFileOptions options = context_->getFileOptions();
+    options.writeBehind = NULL;
+    zhandle_t* handle = context_->getZookeeperHandle();
+    if (handle == NULL) {
+        return ZINVALIDSTATE;
+    }
+    ZooFile file(handle, path, options);
+    return file.setContent(entry.content).getErrorCode();
+}
+
+void WriteBehindQueue::write(const vector<string> &paths, const vector<boost::shared_ptr<Entry> > &entries) {
+    const ZooFileOptions &options = context_->getFileOptions();
+    vector<int> results(entries.size(), ZOK);
+    vector<bool> done(entries.size(), false);
+
+    // Plain payloads below the chunk size can share a transaction, everything else goes through ZooFile
+    vector<size_t> batch;
+    vector<string> stored;
+    size_t batchBytes = 0;
+    for (size_t i = 0; i <= entries.size(); i++) {
+        bool groupable = i < entries.size() && entries[i]->plain &&
+                         (options.chunkSize == 0 || entries[i]->content.length() <= options.chunkSize);
+        string encoded;
+        if (groupable) {
+            encoded = Codec::encode(options.codec, options.compressionThreshold, entries[i]->content);
+        }
+
+        if (i == entries.size() || (groupable && batchBytes + encoded.length() > ZooFile::MAX_TRANSACTION_SIZE)) {
+            zhandle_t* handle = context_->getZookeeperHandle();
+            if (batch.size() > 1 && handle != NULL) {
+                vector<zoo_op_t> ops(batch.size());
+                vector<zoo_op_result_t> opResults(batch.size());
+                for (size_t j = 0; j < batch.size(); j++) {
+                    zoo_set_op_init(&ops[j], paths[batch[j]].c_str(), stored[j].data(), stored[j].length(), -1, NULL);
+                }
+                if (zoo_multi(handle, ops.size(), &ops[0], &opResults[0]) == ZOK) {
+                    for (size_t j = 0; j < batch.size(); j++) {
+                        done[batch[j]] = true;
+                        ZooFile::forgetWritten(options, paths[batch[j]]);
+                    }
+                }
+            }
+            // Singletons and failed transactions are retried one node at a time to attribute errors
+            for (size_t j = 0; j < batch.size(); j++) {
+                if (!done[batch[j]]) {
+                    results[batch[j]] = writeOne(paths[batch[j]], *entries[batch[j]]);
+                    done[batch[j]] = true;
+                }
+            }
+            batch.clear();
+            stored.clear();
+            batchBytes = 0;
+        }
+        if (i == entries.size()) {
+            break;
+        }
+
+        if (groupable) {
+            batch.push_back(i);
+            stored.push_back(encoded);
+            batchBytes += encoded.length() + paths[i].length();
+        } else {
+            results[i] = writeOne(paths[i], *entries[i]);
+            done[i] = true;
+        }
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    for (size_t i = 0; i < entries.size(); i++) {
+        flushes_++;
+        if (results[i] != ZOK) {
+            context_->getLogger().log(Logger::ERROR, "Deferred write of %s failed with error: %d", paths[i].c_str(), results[i]);
+            errors_[paths[i]] = results[i];
+        }
+        EntryMap::iterator it = flushing_.find(paths[i]);
+        if (it != flushing_.end() && it->second == entries[i]) {
+            flushing_.erase(it);
+        }
+    }
+    changed_.notify_all();
+}
+
+int WriteBehindQueue::flush(const string &path) {
+    vector<string> paths;
+    vector<boost::shared_ptr<Entry> > entries;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (flushing_.find(path) != flushing_.end()) {
+            changed_.wait(lock);
+        }
+        EntryMap::iterator it = pending_.find(path);
+        if (it != pending_.end()) {
+            paths.push_back(path);
+            entries.push_back(it->second);
+            flushing_[path] = it->second;
+            pending_.erase(it);
+        }
+    }
+
+    if (!entries.empty()) {
+        write(paths, entries);
+    }
+
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    boost::unordered_map<string, int>::iterator error = errors_.find(path);
+    if (error == errors_.end()) {
+        return ZOK;
+    }
+    int retval = error->second;
+    errors_.erase(error);
+    return retval;
+}
+
+void WriteBehindQueue::flushAll() {
+    vector<string> paths;
+    vector<boost::shared_ptr<Entry> > entries;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        while (!flushing_.empty()) {
+            changed_.wait(lock);
+        }
+        takeDue(true, paths, entries);
+    }
+    if (!entries.empty()) {
+        write(paths, entries);
+    }
+}
+
+uint64_t WriteBehindQueue::getWrites() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return writes_;
+}
+
+uint64_t WriteBehindQueue::getFlushes() const {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return flushes_;
+}
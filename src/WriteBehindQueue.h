@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   WriteBehindQueue.h
+ * Author: kyle
+ *
+ * Created on October 19, 2026, 11:45 AM
+ */
+
+#ifndef WRITEBEHINDQUEUE_H
+#define WRITEBEHINDQUEUE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <zookeeper/zookeeper.h>
+
+using namespace std;
+
+class ZookeeperFuseContext;
+
+/*
+ * Defers content updates so that repeated writes to a node within the window collapse into one zoo_set.
+ *
+ * Only the latest content of a node is kept. A background thread, started by the first write so that it
+ * lives in the daemonized process, flushes nodes once their window has passed since the first pending write,
+ * batching nodes stored as plain payloads into zoo_multi transactions. Failures are remembered per node until
+ * reported by flush, which fsync uses.
+ */
+class WriteBehindQueue {
+public:
+    WriteBehindQueue(ZookeeperFuseContext* context, unsigned int windowMillis);
+    virtual ~WriteBehindQueue();
+
+    // plain is true when the node is known to hold its content directly rather than in chunks
+    void put(const string &path, const string &content, bool plain);
+    bool get(const string &path, string &content) const;
+    bool contains(const string &path) const;
+    void discard(const string &path);
+    // Drops everything pending within the subtree and waits until what is being flushed there has landed
+    void discardTree(const string &root);
+
+    // Writes out anything pending for the node and returns, then clears, the last deferred error
+    int flush(const string &path);
+    void flushAll();
+
+    uint64_t getWrites() const;
+    uint64_t getFlushes() const;
+
+private:
+    WriteBehindQueue(const WriteBehindQueue& orig);
+    WriteBehindQueue& operator=(const WriteBehindQueue &rhs);
+
+    struct Entry {
+        string content;
+        bool plain;
+        boost::posix_time::ptime deadline;
+    };
+
+    typedef boost::unordered_map<string, boost::shared_ptr<Entry> > EntryMap;
+
+    void run();
+    void write(const vector<string> &paths, const vector<boost::shared_ptr<Entry> > &entries);
+    int writeOne(const string &path, const Entry &entry);
+    void takeDue(bool all, vector<string> &paths, vector<boost::shared_ptr<Entry> > &entries);
+
+    ZookeeperFuseContext* context_;
+    const boost::posix_time::time_duration window_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable changed_;
+    EntryMap pending_;
+    // Entries taken by a flush which are not in the zoo yet, so reads keep seeing them
+    EntryMap flushing_;
+    boost::unordered_map<string, int> errors_;
+    uint64_t writes_;
+    uint64_t flushes_;
+    bool stopping_;
+    boost::scoped_ptr<boost::thread> flusher_;
+};
+
+#endif /* WRITEBEHINDQUEUE_H */
@@ -22,14 +22,89 @@
 #include <string.h>
 #include <string>
 #include <iostream>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 #include "ZooFile.h"
+#include "WriteBehindQueue.h"
+#include "ContentCache.h"
+#include "Tracer.h"
+#include "HedgedReads.h"
 
 const size_t ZooFile::MAX_FILE_SIZE = 4096;
+// Stay below the default jute.maxbuffer of 1MB, which also bounds a whole multi request
+const size_t ZooFile::MAX_TRANSACTION_SIZE = 1000 * 1000;
+
+/*
+ * Tracks a window of asynchronous chunk reads for a single file
+ */
+class ChunkFetch {
+public:
+    ChunkFetch(size_t count) :
+    results(count), completed(count, false), outstanding(0), rc(ZOK) {
+
+    }
+
+    vector<string> results;
+    vector<bool> completed;
+    size_t outstanding;
+    int rc;
+    boost::mutex mutex;
+    boost::condition_variable done;
+};
+
+struct ChunkRequest {
+    ChunkFetch* fetch;
+    size_t slot;
+};
 
-ZooFile::ZooFile(zhandle_t* handle, const string &path) :
+static void chunkCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    const ChunkRequest* request = reinterpret_cast<const ChunkRequest*>(data);
+    ChunkFetch* fetch = request->fetch;
+
+    boost::lock_guard<boost::mutex> lock(fetch->mutex);
+    if (rc == ZOK) {
+        fetch->results[request->slot] = valueLength > 0 ? string(value, valueLength) : string();
+        fetch->completed[request->slot] = true;
+    } else if (fetch->rc == ZOK) {
+        fetch->rc = rc;
+    }
+    fetch->outstanding--;
+    fetch->done.notify_all();
+}
+
+static void watchArmed(int rc, const struct Stat *stat, const void *data) {
+
+}
+
+ZooFile::ZooFile(zhandle_t* handle, const string &path, const ZooFileOptions &options) :
+handle_(handle),
+path_(path),
+options_(options),
+watcher_(NULL),
+watcherContext_(NULL),
+stateKnown_(false),
+chunked_(false),
+version_(-1),
+statKnown_(false),
+covered_(true) {
+
+}
+
+ZooFile::ZooFile(zhandle_t* handle, const char *path, const ZooFileOptions &options) :
 handle_(handle),
-path_(path) {
+path_(path),
+options_(options),
+watcher_(NULL),
+watcherContext_(NULL),
+stateKnown_(false),
+chunked_(false),
+version_(-1),
+statKnown_(false),
+covered_(true) {
 
 }
 
@@ -37,77 +112,716 @@ ZooFile::~ZooFile() {
 
 }
 
-bool ZooFile::exits() const {
-    int rc = zoo_exists(handle_, path_.c_str(), 0, NULL);
-    if (rc == ZNONODE) {
-        return false;
+void ZooFile::setWatcher(watcher_fn watcher, void *watcherContext) {
+    watcher_ = watcher;
+    watcherContext_ = watcherContext;
+}
+
+SingleFlight::Result ZooFile::fetch(SingleFlight::Operation operation) const {
+    // Requests made while disconnected wait for the session to come back, possibly for good during quorum loss
+    if (options_.allowReadOnly) {
+        int state = zoo_state(handle_);
+        if (state != ZOO_CONNECTED_STATE && state != ZOO_READONLY_STATE) {
+            SingleFlight::Result retval;
+            retval.rc = ZCONNECTIONLOSS;
+            return retval;
+        }
     }
-    if (rc != ZOK) {
-        throw ZooFileException("An error occurred checking the existence of file: " + path_, rc);
+
+    void (ZooFile::*loader)(SingleFlight::Result&) const;
+    switch (operation) {
+        case SingleFlight::EXISTS:
+            loader = &ZooFile::loadExists;
+            break;
+        case SingleFlight::GET:
+            loader = &ZooFile::loadData;
+            break;
+        default:
+            loader = &ZooFile::loadChildren;
+            break;
+    }
+
+    SingleFlight::Result retval;
+    if (options_.singleFlight) {
+        retval = options_.singleFlight->run(operation, watcher_ != NULL, path_, boost::bind(loader, this, _1));
+    } else {
+        (this->*loader)(retval);
     }
-    return true;
+    covered_ = covered_ && retval.covered;
+    return retval;
 }
 
-bool ZooFile::isDir() const {
-    return !getChildren().empty();
+void ZooFile::loadExists(SingleFlight::Result &result) const {
+    TraceSpan span(options_.tracer, "zoo_exists", path_.c_str());
+    if (options_.hedgedReads) {
+        options_.hedgedReads->run(SingleFlight::EXISTS, handle_, path_, watcher_, watcherContext_, result);
+        return;
+    }
+    result.rc = watcher_ ? zoo_wexists(handle_, path_.c_str(), watcher_, watcherContext_, &result.stat)
+                         : zoo_exists(handle_, path_.c_str(), 0, &result.stat);
 }
 
-vector<string> ZooFile::getChildren() const {
-    vector<string> retval;    
-    String_vector children;
+void ZooFile::loadData(SingleFlight::Result &result) const {
+    TraceSpan span(options_.tracer, "zoo_get", path_.c_str());
+    if (options_.hedgedReads) {
+        options_.hedgedReads->run(SingleFlight::GET, handle_, path_, watcher_, watcherContext_, result);
+        return;
+    }
+    char content[MAX_FILE_SIZE];
+    int contentLength = MAX_FILE_SIZE;
     
-    int rc = zoo_get_children(handle_, path_.c_str(), 0, &children);
-    if (rc != ZOK) {
-        throw ZooFileException("An error occurred getting children of file: " + path_, rc);
-    }    
+    memset( &result.stat, 0, sizeof(result.stat) );
     
+    result.rc = watcher_ ? zoo_wget(handle_, path_.c_str(), watcher_, watcherContext_, content, &contentLength, &result.stat)
+                         : zoo_get(handle_, path_.c_str(), 0, content, &contentLength, &result.stat);
+    if (result.rc != ZOK || contentLength <= 0) {
+        return;
+    }
+    if (result.stat.dataLength <= contentLength) {
+        result.data.assign(content, contentLength);
+        return;
+    }
+
+    // The node outgrew the stack buffer, fetch it again with a buffer of the reported size
+    vector<char> large(result.stat.dataLength);
+    contentLength = large.size();
+    result.rc = zoo_get(handle_, path_.c_str(), 0, &large[0], &contentLength, &result.stat);
+    if (result.rc == ZOK && contentLength > 0) {
+        result.data.assign(&large[0], contentLength);
+    }
+}
+
+void ZooFile::loadChildren(SingleFlight::Result &result) const {
+    TraceSpan span(options_.tracer, "zoo_get_children", path_.c_str());
+    if (options_.hedgedReads) {
+        options_.hedgedReads->run(SingleFlight::CHILDREN, handle_, path_, watcher_, watcherContext_, result);
+        return;
+    }
+    String_vector children;
+
+    result.rc = watcher_ ? zoo_wget_children(handle_, path_.c_str(), watcher_, watcherContext_, &children)
+                         : zoo_get_children(handle_, path_.c_str(), 0, &children);
+    if (result.rc != ZOK) {
+        return;
+    }
     for (int i = 0; i < children.count; i++) {
-        retval.push_back(children.data[i]);
+        result.children.push_back(children.data[i]);
     }
     deallocate_String_vector(&children);
+}
+
+bool ZooFile::getLocal(string &content) const {
+    TraceSpan span(options_.cache || options_.writeBehind ? options_.tracer : NULL, "cache_lookup", path_.c_str());
+    if (options_.writeBehind && options_.writeBehind->get(path_, content)) {
+        return true;
+    }
+    if (options_.cache && options_.cache->get(path_, content)) {
+        armWatch();
+        return true;
+    }
+    return false;
+}
+
+void ZooFile::armWatch() const {
+    // The zoo is skipped, yet the caller still expects to hear about changes
+    if (watcher_ != NULL) {
+        zoo_awexists(handle_, path_.c_str(), watcher_, watcherContext_, watchArmed, NULL);
+    }
+}
+
+bool ZooFile::isCoveredByWatch() const {
+    return covered_;
+}
+
+ZooStatus ZooFile::checkWritable() const {
+    // A read only server would refuse the write anyway, without the round trip
+    int state = options_.allowReadOnly ? zoo_state(handle_) : ZOO_CONNECTED_STATE;
+    if (state == ZOO_READONLY_STATE) {
+        return ZooStatus(ZNOTREADONLY, "writing to a read only session");
+    }
+    if (state != ZOO_CONNECTED_STATE) {
+        return ZooStatus(ZCONNECTIONLOSS, "writing to a disconnected session");
+    }
+    return ZooStatus();
+}
+
+void ZooFile::forgetWritten(const ZooFileOptions &options, const string &path) {
+    if (options.cache) {
+        options.cache->invalidate(path);
+    }
+    if (options.hedgedReads) {
+        options.hedgedReads->forget(path);
+    }
+    if (options.singleFlight) {
+        options.singleFlight->forget(path);
+        // Creations and deletions also change the listing of the parent
+        size_t slash = path.rfind('/');
+        if (slash != string::npos) {
+            options.singleFlight->forget(slash == 0 ? "/" : path.substr(0, slash));
+        }
+    }
+}
+
+void ZooFile::written() {
+    forgetWritten(options_, path_);
+}
+
+ZooResult<bool> ZooFile::exits() const {
+    SingleFlight::Result result = fetch(SingleFlight::EXISTS);
+    if (result.rc == ZNONODE) {
+        return ZooResult<bool>(false);
+    }
+    if (result.rc != ZOK) {
+        return ZooStatus(result.rc, "checking the existence of");
+    }
+    stat_ = result.stat;
+    statKnown_ = true;
+    return ZooResult<bool>(true);
+}
+
+ZooResult<Stat> ZooFile::getStat() const {
+    if (!statKnown_) {
+        ZooResult<bool> exists = exits();
+        if (!exists.ok()) {
+            return exists;
+        }
+        if (!exists.get()) {
+            return ZooStatus(ZNONODE, "getting the stat of");
+        }
+    }
+    return ZooResult<Stat>(stat_);
+}
+
+ZooResult<bool> ZooFile::isDir() const {
+    // The Stat of an earlier exists tells leaves apart without listing them, unless the listing is wanted for its watch
+    if (statKnown_ && stat_.numChildren == 0 && watcher_ == NULL) {
+        return ZooResult<bool>(false);
+    }
+    vector<string> children;
+    ZooStatus status = getAllChildren(children);
+    if (!status.ok()) {
+        return status;
+    }
+    for (size_t i = 0; i < children.size(); i++) {
+        if (!ChunkManifest::isChunkName(children[i])) {
+            return ZooResult<bool>(true);
+        }
+    }
+    return ZooResult<bool>(false);
+}
+
+ZooResult<vector<string> > ZooFile::getChildren() const {
+    ZooResult<vector<string> > retval((vector<string>()));
+    ZooStatus status = getChildren(retval.get());
+    if (!status.ok()) {
+        return status;
+    }
     return retval;
 }
 
-string ZooFile::getContent() const {
-    Stat stat;
-    char content[MAX_FILE_SIZE];
-    int contentLength = MAX_FILE_SIZE;
-    
-    memset( content, 0, MAX_FILE_SIZE );
-    memset( &stat, 0, sizeof(stat) );
-    
-    int rc = zoo_get(handle_, path_.c_str(), 0, content, &contentLength, &stat);
-    if (rc != ZOK) {
-        throw ZooFileException("An error occurred getting the contents of file: " + path_, rc);
+ZooStatus ZooFile::getChildren(vector<string> &children) const {
+    ZooStatus status = getAllChildren(children);
+    children.erase(std::remove_if(children.begin(), children.end(), ChunkManifest::isChunkName), children.end());
+    return status;
+}
+
+ZooStatus ZooFile::getAllChildren(vector<string> &children) const {
+    SingleFlight::Result result = fetch(SingleFlight::CHILDREN);
+    children.clear();
+    if (result.rc != ZOK) {
+        return ZooStatus(result.rc, "getting children of");
     }
-    
-    string retval;
-    if (contentLength > 0) {
-        retval = string(content, contentLength);
-    } else {
-        retval = "";
+    children.swap(result.children);
+    return ZooStatus();
+}
+
+ZooStatus ZooFile::getData(string &data, Stat *stat) const {
+    SingleFlight::Result result = fetch(SingleFlight::GET);
+    if (result.rc != ZOK) {
+        return ZooStatus(result.rc, "getting the contents of");
+    }
+    *stat = result.stat;
+    stat_ = result.stat;
+    statKnown_ = true;
+    data.swap(result.data);
+    return ZooStatus();
+}
+
+bool ZooFile::loadManifest(const string &data, const Stat &stat) const {
+    stateKnown_ = true;
+    version_ = stat.version;
+    chunked_ = ChunkManifest::decode(data.data(), data.length(), manifest_);
+    return chunked_;
+}
+
+ZooStatus ZooFile::decode(const string &data, string &content, size_t maxLength) const {
+    // Corrupt payloads are rare enough for the codec to keep throwing
+    try {
+        content = Codec::decode(data.data(), data.length(), maxLength);
+    } catch (const CodecException &e) {
+        return ZooStatus(ZMARSHALLINGERROR, "decoding the contents of");
+    }
+    return ZooStatus();
+}
+
+ZooStatus ZooFile::fetchChunks(const ChunkManifest &manifest, uint32_t first, uint32_t last, vector<string> &chunks) const {
+    TraceSpan span(options_.tracer, "zoo_get_chunks", path_.c_str());
+    size_t count = last - first + 1;
+    size_t window = std::max<size_t>(options_.chunkConcurrency, 1);
+    ChunkFetch fetch(count);
+    vector<ChunkRequest> requests(count);
+    vector<string> paths(count);
+
+    size_t next = 0;
+    {
+        boost::unique_lock<boost::mutex> lock(fetch.mutex);
+        while (next < count || fetch.outstanding > 0) {
+            while (next < count && fetch.outstanding < window && fetch.rc == ZOK) {
+                requests[next].fetch = &fetch;
+                requests[next].slot = next;
+                paths[next] = path_ + "/" + manifest.getChunkName(first + next);
+
+                int rc = zoo_aget(handle_, paths[next].c_str(), 0, chunkCompletion, &requests[next]);
+                if (rc != ZOK) {
+                    fetch.rc = rc;
+                    break;
+                }
+                fetch.outstanding++;
+                next++;
+            }
+            if (fetch.rc != ZOK && fetch.outstanding == 0) {
+                break;
+            }
+            if (fetch.outstanding > 0) {
+                fetch.done.wait(lock);
+            }
+        }
+    }
+
+    if (fetch.rc != ZOK) {
+        return ZooStatus(fetch.rc, "getting the chunks of");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ZooStatus status = decode(fetch.results[i], fetch.results[i], manifest.getChunkLength(first + i));
+        if (!status.ok()) {
+            return status;
+        }
+        if (fetch.results[i].length() != manifest.getChunkLength(first + i)) {
+            return ZooStatus(ZDATAINCONSISTENCY, "checking the chunk sizes of");
+        }
+    }
+    chunks.swap(fetch.results);
+    return ZooStatus();
+}
+
+ZooResult<string> ZooFile::getContent() const {
+    ZooResult<string> retval(string(""));
+    ZooStatus status = getContent(retval.get());
+    if (!status.ok()) {
+        return status;
     }
-    
     return retval;
 }
 
-void ZooFile::setContent(string content) {
-    int rc = zoo_set(handle_, path_.c_str(), content.c_str(), content.length(), -1);
-    if (rc != ZOK) {
-        throw ZooFileException("An error occurred setting the contents of file: " + path_, rc);    
-    }   
+ZooStatus ZooFile::getContent(string &content) const {
+    content.clear();
+    if (getLocal(content)) {
+        return ZooStatus();
+    }
+
+    Stat stat;
+    string data;
+    ZooStatus status = getData(data, &stat);
+    if (!status.ok()) {
+        return status;
+    }
+
+    if (loadManifest(data, stat)) {
+        if (manifest_.getChunkCount() > 0) {
+            vector<string> chunks;
+            status = fetchChunks(manifest_, 0, manifest_.getChunkCount() - 1, chunks);
+            if (!status.ok()) {
+                return status;
+            }
+            content.reserve(manifest_.getLength());
+            for (size_t i = 0; i < chunks.size(); i++) {
+                content += chunks[i];
+            }
+        }
+        return ZooStatus();
+    }
+
+    return decode(data, content, options_.maxContentSize);
 }
 
-void ZooFile::create() {
+ZooResult<size_t> ZooFile::getSize() const {
+    string pending;
+    if (options_.writeBehind && options_.writeBehind->get(path_, pending)) {
+        return ZooResult<size_t>(pending.length());
+    }
+    size_t length;
+    if (options_.cache && options_.cache->getLength(path_, length)) {
+        armWatch();
+        return ZooResult<size_t>(length);
+    }
+
+    Stat stat;
+    string data;
+    ZooStatus status = getData(data, &stat);
+    if (!status.ok()) {
+        return status;
+    }
+
+    if (loadManifest(data, stat)) {
+        return ZooResult<size_t>(manifest_.getLength());
+    }
+    return ZooResult<size_t>(Codec::decodedLength(data.data(), data.length()));
+}
+
+ZooResult<size_t> ZooFile::read(char *buffer, size_t size, off_t offset) const {
+    string content;
+    bool local = getLocal(content);
+
+    Stat stat;
+    string data;
+    if (!local) {
+        ZooStatus status = getData(data, &stat);
+        if (!status.ok()) {
+            return status;
+        }
+    }
+
+    if (local || !loadManifest(data, stat)) {
+        if (!local) {
+            ZooStatus status = decode(data, content, options_.maxContentSize);
+            if (!status.ok()) {
+                return status;
+            }
+        }
+        if (offset < 0 || static_cast<size_t>(offset) >= content.length()) {
+            return ZooResult<size_t>(0);
+        }
+        size_t length = std::min(size, content.length() - offset);
+        memcpy(buffer, content.data() + offset, length);
+        return ZooResult<size_t>(length);
+    }
+
+    uint64_t length = manifest_.getLength();
+    if (offset < 0 || static_cast<uint64_t>(offset) >= length || size == 0) {
+        return ZooResult<size_t>(0);
+    }
+    uint64_t end = std::min<uint64_t>(length, offset + size);
+    uint32_t first = offset / manifest_.getChunkSize();
+    uint32_t last = (end - 1) / manifest_.getChunkSize();
+
+    vector<string> chunks;
+    ZooStatus status = fetchChunks(manifest_, first, last, chunks);
+    if (!status.ok()) {
+        return status;
+    }
+    size_t copied = 0;
+    for (uint32_t i = first; i <= last; i++) {
+        const string &chunk = chunks[i - first];
+        uint64_t chunkStart = static_cast<uint64_t>(i) * manifest_.getChunkSize();
+        uint64_t from = std::max<uint64_t>(offset, chunkStart) - chunkStart;
+        uint64_t to = std::min<uint64_t>(end, chunkStart + chunk.length()) - chunkStart;
+        memcpy(buffer + copied, chunk.data() + from, to - from);
+        copied += to - from;
+    }
+    return ZooResult<size_t>(copied);
+}
+
+ZooStatus ZooFile::runMulti(vector<zoo_op_t> &ops, const char *action) {
+    if (ops.empty()) {
+        return ZooStatus();
+    }
+    TraceSpan span(options_.tracer, "zoo_multi", path_.c_str());
+    vector<zoo_op_result_t> results(ops.size());
+    int rc = zoo_multi(handle_, ops.size(), &ops[0], &results[0]);
+    return ZooStatus(rc, action);
+}
+
+ZooStatus ZooFile::setPlainContent(const string &content) {
+    string stored = Codec::encode(options_.codec, options_.compressionThreshold, content);
+
+    if (!chunked_) {
+        TraceSpan span(options_.tracer, "zoo_set", path_.c_str());
+        int rc = zoo_set(handle_, path_.c_str(), stored.c_str(), stored.length(), -1);
+        return ZooStatus(rc, "setting the contents of");
+    }
+
+    // Shrinking below the chunk size, replace the manifest and drop the chunks in one transaction
+    vector<string> names(manifest_.getChunkCount());
+    vector<zoo_op_t> ops(names.size() + 1);
+    zoo_set_op_init(&ops[0], path_.c_str(), stored.c_str(), stored.length(), version_, NULL);
+    for (uint32_t i = 0; i < names.size(); i++) {
+        names[i] = path_ + "/" + manifest_.getChunkName(i);
+        zoo_delete_op_init(&ops[i + 1], names[i].c_str(), -1);
+    }
+    ZooStatus status = runMulti(ops, "setting the contents of");
+    if (status.ok()) {
+        chunked_ = false;
+    }
+    return status;
+}
+
+ZooStatus ZooFile::writeChunks(const string &content) {
+    ChunkManifest manifest(content.length(), options_.chunkSize, chunked_ ? manifest_.getGeneration() + 1 : 1);
+    uint32_t count = manifest.getChunkCount();
+
+    vector<string> names(count);
+    vector<string> stored(count);
+    for (uint32_t i = 0; i < count; i++) {
+        names[i] = path_ + "/" + manifest.getChunkName(i);
+        stored[i] = Codec::encode(options_.codec, options_.compressionThreshold,
+                                  content.substr(static_cast<size_t>(i) * manifest.getChunkSize(), manifest.getChunkLength(i)));
+    }
+
+    // The chunks of a new generation are invisible until the manifest points at them, so they can
+    // be created in as many transactions as the size limit requires. Only the switch has to be atomic.
+    vector<zoo_op_t> ops;
+    size_t batchBytes = 0;
+    uint32_t created = 0;
+    ZooStatus status;
+    for (uint32_t i = 0; i < count && status.ok(); i++) {
+        if (!ops.empty() && batchBytes + stored[i].length() > MAX_TRANSACTION_SIZE) {
+            status = runMulti(ops, "writing the chunks of");
+            created += status.ok() ? ops.size() : 0;
+            ops.clear();
+            batchBytes = 0;
+        }
+        zoo_op_t op;
+        zoo_create_op_init(&op, names[i].c_str(), stored[i].data(), stored[i].length(), &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+        ops.push_back(op);
+        batchBytes += stored[i].length() + names[i].length();
+    }
+
+    if (status.ok()) {
+        string encoded = manifest.encode();
+        vector<string> oldNames(chunked_ ? manifest_.getChunkCount() : 0);
+        zoo_op_t op;
+        zoo_set_op_init(&op, path_.c_str(), encoded.data(), encoded.length(), stateKnown_ ? version_ : -1, NULL);
+        ops.push_back(op);
+        for (uint32_t i = 0; i < oldNames.size(); i++) {
+            oldNames[i] = path_ + "/" + manifest_.getChunkName(i);
+            zoo_delete_op_init(&op, oldNames[i].c_str(), -1);
+            ops.push_back(op);
+        }
+        status = runMulti(ops, "writing the manifest of");
+    }
+    if (!status.ok()) {
+        // Best effort removal of the chunks created for the failed generation
+        for (uint32_t i = 0; i < created; i++) {
+            zoo_delete(handle_, names[i].c_str(), -1);
+        }
+        return status;
+    }
+
+    chunked_ = true;
+    manifest_ = manifest;
+    stateKnown_ = false;
+    return status;
+}
+
+ZooStatus ZooFile::setContent(const string &content) {
+    ZooStatus status = checkWritable();
+    if (!status.ok()) {
+        return status;
+    }
+    if (options_.writeBehind) {
+        options_.writeBehind->put(path_, content, stateKnown_ && !chunked_);
+        // Reads made before the put must not be handed to later readers, nor hedged past the flush
+        written();
+        return status;
+    }
+
+    bool chunk = options_.chunkSize > 0 && content.length() > options_.chunkSize;
+
+    // Without a prior read the layout is unknown, the node may have been chunked by another mount or before
+    // chunking was turned off, and its chunks have to go with the rewrite
+    if (!stateKnown_) {
+        Stat stat;
+        string data;
+        status = getData(data, &stat);
+        if (!status.ok()) {
+            return status;
+        }
+        loadManifest(data, stat);
+    }
+
+    status = chunk ? writeChunks(content) : setPlainContent(content);
+    if (status.ok()) {
+        written();
+    }
+    return status;
+}
+
+ZooStatus ZooFile::write(const char *buffer, size_t size, off_t offset) {
+    ZooStatus status = checkWritable();
+    if (!status.ok()) {
+        return status;
+    }
+    if (options_.writeBehind) {
+        ZooResult<string> content = getContent();
+        if (!content.ok()) {
+            return content;
+        }
+        content.get().resize(std::max<size_t>(content.get().length(), offset + size));
+        content.get().replace(offset, size, buffer, size);
+        return setContent(content.get());
+    }
+
+    Stat stat;
+    string data;
+    status = getData(data, &stat);
+    if (!status.ok()) {
+        return status;
+    }
+
+    if (!loadManifest(data, stat)) {
+        string content;
+        status = decode(data, content, options_.maxContentSize);
+        if (!status.ok()) {
+            return status;
+        }
+        content.resize(std::max<size_t>(content.length(), offset + size));
+        content.replace(offset, size, buffer, size);
+        return setContent(content);
+    }
+
+    // Rewrite only the chunks covered by the write, plus the old tail chunk when it has to be padded
+    uint32_t chunkSize = manifest_.getChunkSize();
+    uint32_t oldCount = manifest_.getChunkCount();
+    uint64_t end = offset + size;
+    ChunkManifest manifest = manifest_;
+    manifest.setLength(std::max<uint64_t>(manifest_.getLength(), end));
+
+    uint32_t first = offset / chunkSize;
+    if (oldCount > 0 && first >= oldCount) {
+        first = oldCount - 1;
+    }
+    uint32_t last = size > 0 ? (end - 1) / chunkSize : first;
+    if (static_cast<uint64_t>(last - first + 1) * chunkSize > MAX_TRANSACTION_SIZE) {
+        // A sparse write far past the end, fall back to a full rewrite
+        ZooResult<string> content = getContent();
+        if (!content.ok()) {
+            return content;
+        }
+        content.get().resize(manifest.getLength());
+        content.get().replace(offset, size, buffer, size);
+        return setContent(content.get());
+    }
+
+    vector<string> chunks;
+    if (oldCount > 0 && first < oldCount) {
+        status = fetchChunks(manifest_, first, std::min(last, oldCount - 1), chunks);
+        if (!status.ok()) {
+            return status;
+        }
+    }
+    chunks.resize(last - first + 1);
+
+    vector<string> names(chunks.size());
+    vector<string> stored(chunks.size());
+    vector<zoo_op_t> ops(chunks.size() + 1);
+    for (uint32_t i = first; i <= last; i++) {
+        string &chunk = chunks[i - first];
+        uint64_t chunkStart = static_cast<uint64_t>(i) * chunkSize;
+        chunk.resize(manifest.getChunkLength(i), '\0');
+        if (end > chunkStart && static_cast<uint64_t>(offset) < chunkStart + chunk.length()) {
+            uint64_t from = std::max<uint64_t>(offset, chunkStart);
+            uint64_t to = std::min<uint64_t>(end, chunkStart + chunk.length());
+            chunk.replace(from - chunkStart, to - from, buffer + (from - offset), to - from);
+        }
+
+        names[i - first] = path_ + "/" + manifest.getChunkName(i);
+        stored[i - first] = Codec::encode(options_.codec, options_.compressionThreshold, chunk);
+        const string &value = stored[i - first];
+        if (i < oldCount) {
+            zoo_set_op_init(&ops[i - first], names[i - first].c_str(), value.data(), value.length(), -1, NULL);
+        } else {
+            zoo_create_op_init(&ops[i - first], names[i - first].c_str(), value.data(), value.length(), &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
+        }
+    }
+
+    string encoded = manifest.encode();
+    zoo_set_op_init(&ops[chunks.size()], path_.c_str(), encoded.data(), encoded.length(), version_, NULL);
+    status = runMulti(ops, "writing the chunks of");
+    if (!status.ok()) {
+        return status;
+    }
+    written();
+
+    manifest_ = manifest;
+    stateKnown_ = false;
+    return status;
+}
+
+ZooStatus ZooFile::sync() {
+    if (options_.writeBehind) {
+        return ZooStatus(options_.writeBehind->flush(path_), "pushing out deferred writes of");
+    }
+    return ZooStatus();
+}
+
+ZooStatus ZooFile::create() {
+    ZooStatus status = checkWritable();
+    if (!status.ok()) {
+        return status;
+    }
+    TraceSpan span(options_.tracer, "zoo_create", path_.c_str());
     int rc = zoo_create(handle_, path_.c_str(), NULL, 0, &ZOO_OPEN_ACL_UNSAFE, 0, NULL, 0);
     if (rc != ZOK) {
-        throw ZooFileException("An error occurred creating the file: " + path_, rc);
+        return ZooStatus(rc, "creating");
     }      
+    written();
+    return status;
 }
 
-void ZooFile::remove() {
-    int rc = zoo_delete(handle_, path_.c_str(), -1);
+ZooStatus ZooFile::remove() {
+    ZooStatus status = checkWritable();
+    if (!status.ok()) {
+        return status;
+    }
+    if (options_.writeBehind) {
+        options_.writeBehind->discard(path_);
+    }
+
+    int rc;
+    {
+        TraceSpan span(options_.tracer, "zoo_delete", path_.c_str());
+        rc = zoo_delete(handle_, path_.c_str(), -1);
+    }
+    if (rc == ZNOTEMPTY) {
+        // A chunked file, remove its chunks along with it as long as they are its only children
+        vector<string> children;
+        status = getAllChildren(children);
+        if (!status.ok()) {
+            return status;
+        }
+        bool onlyChunks = true;
+        for (size_t i = 0; i < children.size(); i++) {
+            onlyChunks = onlyChunks && ChunkManifest::isChunkName(children[i]);
+        }
+        if (onlyChunks) {
+            vector<string> names(children.size());
+            vector<zoo_op_t> ops(names.size() + 1);
+            for (size_t i = 0; i < names.size(); i++) {
+                names[i] = path_ + "/" + children[i];
+                zoo_delete_op_init(&ops[i], names[i].c_str(), -1);
+            }
+            zoo_delete_op_init(&ops[names.size()], path_.c_str(), -1);
+            status = runMulti(ops, "deleting");
+            if (status.ok()) {
+                written();
+            }
+            return status;
+        }
+    }
     if (rc != ZOK) {
-        throw ZooFileException("An error occurred deleting the file: " + path_, rc);
+        return ZooStatus(rc, "deleting");
     }         
+    written();
+    return status;
 }
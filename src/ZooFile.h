@@ -29,6 +29,16 @@
 #include <boost/shared_ptr.hpp>
 #include <zookeeper/zookeeper.h>
 
+#include "codec/Codec.h"
+#include "ChunkManifest.h"
+#include "SingleFlight.h"
+#include "ZooStatus.h"
+
+class WriteBehindQueue;
+class ContentCache;
+class Tracer;
+class HedgedReads;
+
 using namespace std;
 using namespace boost;
 
@@ -57,27 +67,113 @@ private:
     int rc_;
 };
 
+/*
+ * Per-mount settings controlling how node contents are stored in the zoo
+ */
+struct ZooFileOptions {
+    ZooFileOptions() :
+    codec(NULL), compressionThreshold(0), chunkSize(0), chunkConcurrency(4), singleFlight(NULL), writeBehind(NULL), cache(NULL), tracer(NULL),
+    hedgedReads(NULL), allowReadOnly(false), maxContentSize(1024) {
+
+    }
+
+    const Codec* codec;
+    size_t compressionThreshold;
+    // Contents larger than chunkSize are split across child chunk nodes, 0 disables chunking
+    size_t chunkSize;
+    // Maximum number of chunk reads in flight for a single file
+    size_t chunkConcurrency;
+    // Shares the results of identical concurrent reads when set
+    SingleFlight* singleFlight;
+    // Defers content updates when set, reads see the pending content
+    WriteBehindQueue* writeBehind;
+    // Serves contents loaded ahead of time when set
+    ContentCache* cache;
+    // Records a span for every zookeeper call when set
+    Tracer* tracer;
+    // Bounds reads by a deadline and hedges slow ones when set
+    HedgedReads* hedgedReads;
+    // Sessions may be read only, writes then fail with ZNOTREADONLY and reads made while disconnected fail at once
+    bool allowReadOnly;
+    // Compressed contents claiming to be larger are refused, a corrupt header must not make reads allocate gigabytes
+    size_t maxContentSize;
+};
+
 class ZooFile {
 public:
     static const size_t MAX_FILE_SIZE;
+    static const size_t MAX_TRANSACTION_SIZE;
+
+    // Drops what the cache, single flight and hedged reads remember of a node written outside a ZooFile
+    static void forgetWritten(const ZooFileOptions &options, const string &path);
     
-    ZooFile(zhandle_t*, const string &path);
+    ZooFile(zhandle_t*, const string &path, const ZooFileOptions &options = ZooFileOptions());
+    ZooFile(zhandle_t*, const char *path, const ZooFileOptions &options = ZooFileOptions());
     ZooFile(const ZooFile& orig);
     virtual ~ZooFile();
     
-    bool exits() const;
-    bool isDir() const;
+    // A missing node is not an error, its result is false
+    ZooResult<bool> exits() const;
+    ZooResult<bool> isDir() const;
+    // Stat of the node as last seen by this file, only asking the zoo if nothing was read yet
+    ZooResult<Stat> getStat() const;
     
-    vector<string> getChildren() const;
-    string getContent() const;
-    void remove();
+    ZooResult<vector<string> > getChildren() const;
+    ZooResult<string> getContent() const;
+    // Same as above, replacing the contents of storage owned by the caller
+    ZooStatus getChildren(vector<string> &children) const;
+    ZooStatus getContent(string &content) const;
+    ZooResult<size_t> getSize() const;
+    // Reads at most size bytes from offset, only fetching the chunks covering the range
+    ZooResult<size_t> read(char *buffer, size_t size, off_t offset) const;
+    ZooStatus remove();
     
-    void setContent(string);
-    void create();
+    ZooStatus setContent(const string &content);
+    ZooStatus write(const char *buffer, size_t size, off_t offset);
+    // Pushes out deferred writes of the node, failing if any of them failed
+    ZooStatus sync();
+    ZooStatus create();
+
+    // Leaves a watch with the given watcher on every node the file reads
+    void setWatcher(watcher_fn watcher, void *watcherContext);
+    // False once a read was answered by a hedge or from stale answers, changes made before the watch was
+    // armed may then go unnoticed and what was read must not be kept until the watch fires
+    bool isCoveredByWatch() const;
     
 private:
+    SingleFlight::Result fetch(SingleFlight::Operation operation) const;
+    void loadExists(SingleFlight::Result &result) const;
+    void loadData(SingleFlight::Result &result) const;
+    void loadChildren(SingleFlight::Result &result) const;
+    // Content pending in the write behind queue or cached, without asking the zoo
+    bool getLocal(string &content) const;
+    void armWatch() const;
+    void written();
+    ZooStatus checkWritable() const;
+
+    ZooStatus getData(string &data, Stat *stat) const;
+    bool loadManifest(const string &data, const Stat &stat) const;
+    ZooStatus getAllChildren(vector<string> &children) const;
+    ZooStatus fetchChunks(const ChunkManifest &manifest, uint32_t first, uint32_t last, vector<string> &chunks) const;
+    ZooStatus decode(const string &data, string &content, size_t maxLength) const;
+    ZooStatus writeChunks(const string &content);
+    ZooStatus setPlainContent(const string &content);
+    ZooStatus runMulti(vector<zoo_op_t> &ops, const char *action);
+
     zhandle_t* handle_;
     const string path_;
+    const ZooFileOptions options_;
+    watcher_fn watcher_;
+    void* watcherContext_;
+
+    // What the last read of the node found, lets writes replace chunks without listing children
+    mutable bool stateKnown_;
+    mutable bool chunked_;
+    mutable ChunkManifest manifest_;
+    mutable int32_t version_;
+    mutable bool statKnown_;
+    mutable Stat stat_;
+    mutable bool covered_;
 };
 
 #endif	/* ZOOFILE_H */
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZooStatus.cpp
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 3:40 PM
+ */
+
+#include <errno.h>
+
+#include "ZooStatus.h"
+
+struct ErrnoMapping {
+    int rc;
+    int error;
+};
+
+static const ErrnoMapping ERRNO_TABLE[] = {
+    { ZOK, 0 },
+    { ZNONODE, ENOENT },
+    { ZNOAUTH, EACCES },
+    { ZAUTHFAILED, EACCES },
+    { ZNODEEXISTS, EEXIST },
+    { ZNOTEMPTY, ENOTEMPTY },
+    { ZNOCHILDRENFOREPHEMERALS, EPERM },
+    { ZBADARGUMENTS, EINVAL },
+    { ZOPERATIONTIMEOUT, ETIMEDOUT },
+    { ZNOTREADONLY, EROFS }
+};
+
+int zooErrno(int rc) {
+    for (size_t i = 0; i < sizeof (ERRNO_TABLE) / sizeof (ERRNO_TABLE[0]); i++) {
+        if (ERRNO_TABLE[i].rc == rc) {
+            return ERRNO_TABLE[i].error;
+        }
+    }
+    return EIO;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZooStatus.h
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 3:40 PM
+ */
+
+#ifndef ZOOSTATUS_H
+#define ZOOSTATUS_H
+
+#include <cstddef>
+#include <zookeeper/zookeeper.h>
+
+// Errno reported to fuse for a zookeeper return code, 0 for ZOK. Shared by every callback
+int zooErrno(int rc);
+
+/*
+ * Outcome of an operation on the zoo: the zookeeper return code and what was being done when it failed.
+ *
+ * Missing nodes, lost connections and refused writes are everyday outcomes, so they are returned rather
+ * than thrown. Nothing is allocated, the action must be a string literal.
+ */
+class ZooStatus {
+public:
+    ZooStatus() :
+    rc_(ZOK), action_(NULL) {
+
+    }
+
+    ZooStatus(int rc, const char *action) :
+    rc_(rc), action_(action) {
+
+    }
+
+    bool ok() const {
+        return rc_ == ZOK;
+    }
+
+    int getErrorCode() const {
+        return rc_;
+    }
+
+    // e.g. "getting the contents of", for log messages naming the file
+    const char* getAction() const {
+        return action_ != NULL ? action_ : "accessing";
+    }
+
+    int getErrno() const {
+        return zooErrno(rc_);
+    }
+
+private:
+    int rc_;
+    const char *action_;
+};
+
+/*
+ * A value, valid when the status is ok
+ */
+template <typename T>
+class ZooResult : public ZooStatus {
+public:
+    ZooResult(const T &value) :
+    value_(value) {
+
+    }
+
+    ZooResult(const ZooStatus &status) :
+    ZooStatus(status), value_() {
+
+    }
+
+    const T& get() const {
+        return value_;
+    }
+
+    T& get() {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+#endif /* ZOOSTATUS_H */
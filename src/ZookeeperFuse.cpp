@@ -23,21 +23,33 @@
 #include <zookeeper/zookeeper.h>
 #include <fuse.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <set>
 #include <iostream>
 #include <errno.h>
 #include <stdio.h>
 #include <getopt.h>
 #include <memory.h>
 #include <unistd.h>
-#include <boost/filesystem.hpp>
+#include <signal.h>
+#include <poll.h>
 
 #include "ZooFile.h"
+#include "DirectoryListing.h"
 #include "ZookeeperFuseContext.h"
+#include "ZookeeperFuseLowLevel.h"
+#include "MountDaemon.h"
+#include "RequestScheduler.h"
+#include "StatAttributes.h"
+#include "Tracer.h"
 
 using namespace std;
 
 static int getattr_callback(const char *path, struct stat *stbuf);
 static int readdir_callback(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi);
+static int opendir_callback(const char *path, struct fuse_file_info *fi);
+static int releasedir_callback(const char *path, struct fuse_file_info *fi);
 static int open_callback(const char *path, struct fuse_file_info *fi);
 static int read_callback(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
 static int write_callback(const char *, const char *, size_t, off_t, struct fuse_file_info *);
@@ -48,19 +60,66 @@ static int create_callback(const char *, mode_t, struct fuse_file_info *);
 static int truncate_callback(const char *, off_t);
 static int unlink_callback(const char *);
 static int mkdir_callback(const char*, mode_t);
+static int fsync_callback(const char *, int, struct fuse_file_info *);
+static int getxattr_callback(const char *, const char *, char *, size_t);
+static int listxattr_callback(const char *, char *, size_t);
+static int flush_callback(const char *, struct fuse_file_info *);
+static int release_callback(const char *, struct fuse_file_info *);
+static int poll_callback(const char *, struct fuse_file_info *, struct fuse_pollhandle *, unsigned *);
 
-const static string dataNodeName = "_zoo_data_";
+const static string dataNodeName = ZookeeperFuseContext::DATA_NODE_NAME;
+
+// Virtual files streaming subtree archives, <path> below export or import names the subtree in the mount
+const static string archiveDir = "/.zkfuse";
+const static string exportDir = archiveDir + "/export";
+const static string importDir = archiveDir + "/import";
+
+enum ArchiveEntry {
+    ARCHIVE_NONE,
+    ARCHIVE_DIRECTORY,
+    ARCHIVE_EXPORT,
+    ARCHIVE_IMPORT
+};
+
+// Kept in fuse_file_info::fh of open files, the entry of files backed by a node is ARCHIVE_NONE
+struct FileHandle {
+    ArchiveEntry entry;
+    string zooPath;
+    string content;
+    bool imported;
+    // Generation of the node the file last read and the node it polls, see PollRegistry
+    uint64_t seen;
+    string polled;
+};
 static struct fuse_operations fuse_zoo_operations;
 
 #define LOG(context, level, msg, ...) \
     context->getLogger().log(level, msg, __VA_ARGS__)
 
+// Every callback starts with this, the request arena is released when it returns
+#define CALLBACK_INIT(callback, path) \
+    RequestArena::Scope arenaScope; \
+    callback_init(callback, path)
+
+// Opens the root span of a callback, closed when the callback returns
+#define TRACE_CALLBACK(callback, path) \
+    TraceSpan callbackSpan(ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context())->getTracer(), callback, path, true)
+
+// Captures the callback for replay when --record is given
+#define RECORD_CALLBACK(op, path, ...) \
+    RecordedOp recordedOp(ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context())->getRecorder(), op, path, ##__VA_ARGS__)
+
+// Holds the callback until the scheduler admits it to the session, when --rateLimit or --maxOutstanding is given
+#define SCHEDULE_CALLBACK(opClass) \
+    Admission admission(ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context())->getScheduler(), \
+                        RequestScheduler::opClass, fuse_get_context()->pid, fuse_get_context()->uid)
+
 /*
  * ZookeeperFuse Main Function
  *
  * Parses command line arguments. Everything before an empty "--" are handled by fuse, everything after by us
  * Registers the fuse callbacks.
- * Creates the zookeeper connection/context.
+ * Creates the zookeeper connection/context, one per ensemble when --mounts lists several mounts.
  * 
  * Two display modes are supported for leaf nodes, each has its quirks
  * 1. LEAF_AS_DIR  - Display all leaf nodes as directories, make their data available in a special child data node
@@ -77,6 +136,29 @@ int main(int argc, char** argv) {
     size_t maxFileSize = 1024;
     Logger::LogLevel logLevel = Logger::INFO;
     string logPropFile;
+    Codec::Type compression = Codec::NONE;
+    size_t compressionThreshold = 256;
+    size_t chunkSize = 0;
+    size_t chunkConcurrency = 4;
+    bool lowLevel = false;
+    size_t maxInFlight = 0;
+    bool coalesceReads = false;
+    unsigned int writeBehind = 0;
+    size_t prefetch = 0;
+    bool nearestServers = false;
+    bool allowReadOnly = false;
+    unsigned int readDeadline = 0;
+    bool hedgeReads = false;
+    bool staleReads = false;
+    string traceFile;
+    unsigned int traceSample = 1;
+    size_t traceWindow = Tracer::DEFAULT_WINDOW;
+    string recordFile;
+    string mountsFile;
+    double rates[RequestScheduler::CLASS_COUNT] = { 0 };
+    size_t maxOutstanding = 0;
+    set<uid_t> bulkUids;
+    unsigned int scanRate = 500;
 
     string division = "--";
     int argumentDivider = 0;
@@ -98,10 +180,33 @@ int main(int argc, char** argv) {
         { "leafMode", required_argument, NULL, 'l'},
         { "maxFileSize", required_argument, NULL, 'm'},
         { "logLevel", required_argument, NULL, 'd'},
+        { "compression", required_argument, NULL, 'c'},
+        { "compressionThreshold", required_argument, NULL, 'C'},
+        { "chunkSize", required_argument, NULL, 'k'},
+        { "chunkConcurrency", required_argument, NULL, 'K'},
+        { "lowLevel", no_argument, NULL, 'L'},
+        { "asyncDispatch", required_argument, NULL, 'D'},
+        { "coalesceReads", no_argument, NULL, 'R'},
+        { "writeBehind", required_argument, NULL, 'w'},
+        { "prefetch", required_argument, NULL, 'P'},
+        { "nearestServers", no_argument, NULL, 'N'},
+        { "allowReadOnly", no_argument, NULL, 'o'},
+        { "readDeadline", required_argument, NULL, 'e'},
+        { "hedgeReads", no_argument, NULL, 'H'},
+        { "staleReads", no_argument, NULL, 'S'},
+        { "trace", required_argument, NULL, 't'},
+        { "traceSample", required_argument, NULL, 'T'},
+        { "traceWindow", required_argument, NULL, 'W'},
+        { "record", required_argument, NULL, 'r'},
+        { "mounts", required_argument, NULL, 'M'},
+        { "rateLimit", required_argument, NULL, 'q'},
+        { "maxOutstanding", required_argument, NULL, 'O'},
+        { "bulkUids", required_argument, NULL, 'B'},
+        { "scanRate", required_argument, NULL, 'b'},
         { 0, 0, 0, 0}
     };
     char c;
-    while ((c = getopt_long(argc - argumentDivider, argv + argumentDivider, "hf:s:a:d:l:", longopts, NULL)) != -1) {
+    while ((c = getopt_long(argc - argumentDivider, argv + argumentDivider, "hf:s:a:d:l:c:C:k:K:LD:Rw:P:Noe:HSt:T:W:r:M:q:O:B:b:", longopts, NULL)) != -1) {
         switch (c) {
             case 'h':
                 cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
@@ -112,7 +217,30 @@ int main(int argc, char** argv) {
                         "--zooAuthentication -a          zookeeper authentication string\n"
                         "--leafMode          -l          display mode for leaves, DIR or FILE (default=DIR)\n"
                         "--maxFileSize       -m          maximum size in bytes of file in the zoo (default=1024)\n"
-                        "--logLevel          -d          verbosity of logging ERROR, WARNING, INFO, DEBUG, TRACE\n";
+                        "--logLevel          -d          verbosity of logging ERROR, WARNING, INFO, DEBUG, TRACE\n"
+                        "--compression       -c          codec for compressing file contents, NONE, LZ4 or ZSTD (default=NONE)\n"
+                        "--compressionThreshold -C       minimum size in bytes of contents to compress (default=256)\n"
+                        "--chunkSize         -k          split contents larger than this many bytes across child nodes (default=0, disabled)\n"
+                        "--chunkConcurrency  -K          maximum parallel chunk reads per file (default=4)\n"
+                        "--lowLevel          -L          serve the mount through the fuse low level api\n"
+                        "--asyncDispatch     -D          answer reads from zookeeper completions with at most this many in flight, implies --lowLevel\n"
+                        "--coalesceReads     -R          share the result of identical concurrent reads of a node\n"
+                        "--writeBehind       -w          collapse writes to a node within this many milliseconds into one update (default=0, disabled)\n"
+                        "--prefetch          -P          cache up to this many bytes of contents read ahead of directory scans (default=0, disabled)\n"
+                        "--nearestServers    -N          probe the servers and connect to the nearest ones, preferring observers\n"
+                        "--allowReadOnly     -o          keep serving reads from servers without quorum, writes fail with EROFS meanwhile\n"
+                        "--readDeadline      -e          fail reads not answered within this many milliseconds with ETIMEDOUT (default=0, disabled)\n"
+                        "--hedgeReads        -H          re-send reads slower than the p95 on a second session, using the first answer\n"
+                        "--staleReads        -S          answer reads missing the deadline with the last answer seen instead of failing\n"
+                        "--trace             -t          record callback and zookeeper spans, written as Chrome trace events to this file on SIGUSR2 and unmount\n"
+                        "--traceSample       -T          trace one in this many callbacks (default=1)\n"
+                        "--traceWindow       -W          keep this many of the latest spans for the trace file, about 140 bytes each (default=100000)\n"
+                        "--record            -r          capture every callback to this file for zookeeperfuse-replay, high level api only\n"
+                        "--mounts            -M          serve every mount listed in this file from one process, sharing a session per ensemble\n"
+                        "--rateLimit         -q          requests per second sent to the zoo by class, i.e. stat=2000,read=1000,list=100,write=50\n"
+                        "--maxOutstanding    -O          maximum requests sent to the zoo at once (default=0, unlimited)\n"
+                        "--bulkUids          -B          comma separated uids whose requests are served after everyone else's\n"
+                        "--scanRate          -b          treat processes sending more requests a second than this as bulk (default=500, 0 disables)\n";
                 exit(0);
                 break;
             case 'f':
@@ -136,13 +264,97 @@ int main(int argc, char** argv) {
             case 'd':
                 logLevel = Logger::stringToLevel(optarg);
                 break;
+            case 'c':
+                compression = Codec::stringToType(optarg);
+                break;
+            case 'C':
+                compressionThreshold = atoi(optarg);
+                break;
+            case 'k':
+                chunkSize = atoi(optarg);
+                break;
+            case 'K':
+                chunkConcurrency = atoi(optarg);
+                break;
+            case 'L':
+                lowLevel = true;
+                break;
+            case 'D':
+                maxInFlight = atoi(optarg);
+                lowLevel = true;
+                break;
+            case 'R':
+                coalesceReads = true;
+                break;
+            case 'w':
+                writeBehind = atoi(optarg);
+                break;
+            case 'P':
+                prefetch = atol(optarg);
+                break;
+            case 'N':
+                nearestServers = true;
+                break;
+            case 'o':
+                allowReadOnly = true;
+                break;
+            case 'e':
+                readDeadline = atoi(optarg);
+                break;
+            case 'H':
+                hedgeReads = true;
+                break;
+            case 'S':
+                staleReads = true;
+                break;
+            case 't':
+                traceFile = optarg;
+                break;
+            case 'T':
+                traceSample = atoi(optarg);
+                break;
+            case 'W':
+                traceWindow = atol(optarg);
+                break;
+            case 'r':
+                recordFile = optarg;
+                break;
+            case 'M':
+                mountsFile = optarg;
+                break;
+            case 'q':
+                if (!RequestScheduler::parseRates(optarg, rates)) {
+                    cerr << "Invalid rate limit " << optarg << ", expected class=rate pairs of stat, read, list and write" << endl;
+                    return 1;
+                }
+                break;
+            case 'O':
+                maxOutstanding = atoi(optarg);
+                break;
+            case 'B':
+                if (!RequestScheduler::parseUids(optarg, bulkUids)) {
+                    cerr << "Invalid uid list " << optarg << endl;
+                    return 1;
+                }
+                break;
+            case 'b':
+                scanRate = atoi(optarg);
+                break;
         }
     }
 
+    // Only the high level callbacks capture operations, a low level mount would leave an empty capture
+    if (lowLevel && !recordFile.empty()) {
+        cerr << "--record captures the high level api and can not be combined with --lowLevel or --asyncDispatch" << endl;
+        return 1;
+    }
+
     fuse_zoo_operations.getattr = getattr_callback;
     fuse_zoo_operations.open = open_callback;
     fuse_zoo_operations.read = read_callback;
     fuse_zoo_operations.readdir = readdir_callback;
+    fuse_zoo_operations.opendir = opendir_callback;
+    fuse_zoo_operations.releasedir = releasedir_callback;
     fuse_zoo_operations.write = write_callback;
     fuse_zoo_operations.chmod = chmod_callback;
     fuse_zoo_operations.chown = chown_callback;
@@ -152,56 +364,215 @@ int main(int argc, char** argv) {
     fuse_zoo_operations.unlink = unlink_callback;
     fuse_zoo_operations.rmdir = unlink_callback;
     fuse_zoo_operations.mkdir = mkdir_callback;
+    fuse_zoo_operations.fsync = fsync_callback;
+    fuse_zoo_operations.getxattr = getxattr_callback;
+    fuse_zoo_operations.listxattr = listxattr_callback;
+    fuse_zoo_operations.flush = flush_callback;
+    fuse_zoo_operations.release = release_callback;
+    fuse_zoo_operations.poll = poll_callback;
     
-    auto_ptr<ZookeeperFuseContext> context(
-        new ZookeeperFuseContext(logLevel, zooHosts, zooAuthScheme, zooAuthentication, zooPath, leafMode, maxFileSize));
+    MountConfig defaults;
+    defaults.hosts = zooHosts;
+    defaults.authScheme = zooAuthScheme;
+    defaults.auth = zooAuthentication;
+    defaults.zooPath = zooPath;
+    defaults.leafMode = leafMode;
+    defaults.maxFileSize = maxFileSize;
+
+    vector<MountConfig> mounts;
+    if (mountsFile.empty()) {
+        mounts.push_back(defaults);
+    } else {
+        if (lowLevel || !traceFile.empty() || !recordFile.empty()) {
+            cerr << "--mounts serves through the high level api and can not be combined with --lowLevel, --asyncDispatch, --trace or --record" << endl;
+            return 1;
+        }
+        try {
+            mounts = readMountConfig(mountsFile, defaults);
+        } catch (const MountConfigException &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+        if (mounts.empty()) {
+            cerr << "No mounts listed in " << mountsFile << endl;
+            return 1;
+        }
+    }
+
+    // Mounts of the same ensemble use the session and caches of the first of them
+    vector<boost::shared_ptr<ZookeeperFuseContext> > contexts;
+    map<string, ZookeeperFuseContext*> owners;
+    for (size_t i = 0; i < mounts.size(); i++) {
+        boost::shared_ptr<ZookeeperFuseContext> context(
+            new ZookeeperFuseContext(logLevel, mounts[i].hosts, mounts[i].authScheme, mounts[i].auth, mounts[i].zooPath,
+                                     mounts[i].leafMode, mounts[i].maxFileSize));
+        contexts.push_back(context);
+
+        map<string, ZookeeperFuseContext*>::iterator owner = owners.find(mounts[i].getEnsembleKey());
+        if (owner != owners.end()) {
+            context->shareSession(owner->second);
+            continue;
+        }
+        owners[mounts[i].getEnsembleKey()] = context.get();
+
+        if (!context->setCompression(compression, compressionThreshold)) {
+            cerr << "Compression codec " << Codec::typeToString(compression) << " is not supported by this build" << endl;
+            return 1;
+        }
+        context->setChunking(chunkSize, chunkConcurrency);
+        context->setCoalesceReads(coalesceReads);
+        context->setWriteBehind(writeBehind);
+        context->setPrefetch(prefetch);
+        context->setAllowReadOnly(allowReadOnly);
+        context->setServerSelection(nearestServers);
+        context->setHedgedReads(readDeadline, hedgeReads, staleReads);
+        context->setScheduling(rates, maxOutstanding, bulkUids, scanRate);
+        context->setTrace(traceFile, traceSample, traceWindow);
+        if (context->getTracer()) {
+            signal(SIGUSR2, Tracer::requestWrite);
+        }
+        if (!context->setRecord(recordFile)) {
+            cerr << "Could not create the capture file " << recordFile << endl;
+            return 1;
+        }
+    }
+
+    if (!mountsFile.empty()) {
+        vector<ZookeeperFuseContext*> served;
+        for (size_t i = 0; i < contexts.size(); i++) {
+            served.push_back(contexts[i].get());
+        }
+        return runMounts(argumentDivider, argv, mounts, served, &fuse_zoo_operations);
+    }
+
+    if (lowLevel) {
+        return runLowLevel(argumentDivider, argv, contexts.front().get(), maxInFlight);
+    }
     
-    return fuse_main(argumentDivider, argv, &fuse_zoo_operations, context.get());
+    return fuse_main(argumentDivider, argv, &fuse_zoo_operations, contexts.front().get());
 }
 
-static string getFullPath(string path) {
+// Valid until the callback returns, see CALLBACK_INIT
+static const char* getFullPath(const char *path) {
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
-    
-    string retval = context->getPath();
+    return context->resolvePath(path, RequestArena::get());
+}
 
-    // Avoid duplicate "/" issues at the start of paths
-    if (retval == "/") {
-        retval = "";
-    }
+static void callback_init(const char *callback, const char *path) {
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+    LOG(context, Logger::DEBUG, "In: %s. Path: %s", callback, path);
+}
 
-    if (boost::filesystem::path(path).filename() == dataNodeName) {
-        retval += boost::filesystem::path(path).parent_path().string();
-        LOG(context, Logger::DEBUG, "Requesting the data node... aliasing to: %s", retval.c_str());        
-    } else {
-        retval += path;
-        LOG(context, Logger::DEBUG, "Requesting a regular node: %s", retval.c_str());
+static bool isBelow(const char *path, const string &dir) {
+    return strncmp(path, dir.c_str(), dir.length()) == 0 && path[dir.length()] == '/';
+}
+
+static int zooError(ZookeeperFuseContext* context, const ZooStatus &status) {
+    LOG(context, Logger::ERROR, "Zookeeper Error: %d while %s", status.getErrorCode(), status.getAction());
+    return -status.getErrno();
+}
+
+static ArchiveEntry getArchiveEntry(const char *path, string &target) {
+    if (archiveDir == path || exportDir == path || importDir == path) {
+        return ARCHIVE_DIRECTORY;
     }
-            
-    // Must avoid ending the path in "/" unless we are looking at the root, zookeeper is picky
-    if (retval.length() > 1 && *(retval.rbegin())  == '/') {
-        retval.erase(retval.length() - 1);
+    if (isBelow(path, exportDir)) {
+        target = path + exportDir.length();
+        return ARCHIVE_EXPORT;
     }
-    
-    return retval;
+    if (isBelow(path, importDir)) {
+        target = path + importDir.length();
+        return ARCHIVE_IMPORT;
+    }
+    return ARCHIVE_NONE;
+}
+
+static FileHandle* getFileHandle(struct fuse_file_info *fi) {
+    return fi != NULL ? reinterpret_cast<FileHandle*>(fi->fh) : NULL;
+}
+
+static FileHandle* getArchiveHandle(struct fuse_file_info *fi) {
+    FileHandle* handle = getFileHandle(fi);
+    return handle != NULL && handle->entry != ARCHIVE_NONE ? handle : NULL;
+}
+
+static int openArchive(ArchiveEntry entry, const string &target, struct fuse_file_info *fi) {
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+    auto_ptr<FileHandle> handle(new FileHandle());
+    handle->entry = entry;
+    handle->zooPath = getFullPath(target.c_str());
+    handle->imported = false;
+    handle->seen = 0;
+
+    if (entry == ARCHIVE_EXPORT) {
+        try {
+            handle->content = context->getArchive().exportTree(handle->zooPath);
+            LOG(context, Logger::INFO, "Exported %s as %lu bytes", handle->zooPath.c_str(), (unsigned long) handle->content.length());
+        } catch (const ZooFileException &e) {
+            LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
+            return -zooErrno(e.getErrorCode());
+        }
+    }
+
+    // Archive sizes are unknown to getattr, bypass the page cache so reads are not cut short
+    fi->direct_io = 1;
+    fi->fh = reinterpret_cast<uint64_t>(handle.release());
+    return 0;
 }
 
-static void callback_init(const string &callback, const string &path) {
+static void openNode(const char *path, struct fuse_file_info *fi) {
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
-    LOG(context, Logger::DEBUG, "In: %s. Path: %s", callback.c_str(), path.c_str());
+    FileHandle* handle = new FileHandle();
+    handle->entry = ARCHIVE_NONE;
+    handle->zooPath = getFullPath(path);
+    handle->imported = false;
+    handle->seen = context->getPollRegistry().getGeneration();
+    fi->fh = reinterpret_cast<uint64_t>(handle);
 }
 
 static int getattr_callback(const char *path, struct stat *stbuf) {
-    callback_init("getattr_callback", path);
+    CALLBACK_INIT("getattr_callback", path);
+    TRACE_CALLBACK("getattr_callback", path);
+    RECORD_CALLBACK(OP_GETATTR, path);
     memset(stbuf, 0, sizeof (struct stat));
+
+    string target;
+    switch (getArchiveEntry(path, target)) {
+        case ARCHIVE_DIRECTORY:
+            stbuf->st_mode = S_IFDIR | 0755;
+            stbuf->st_nlink = 2;
+            return 0;
+        case ARCHIVE_EXPORT:
+            stbuf->st_mode = S_IFREG | 0444;
+            stbuf->st_nlink = 1;
+            return 0;
+        case ARCHIVE_IMPORT:
+            stbuf->st_mode = S_IFREG | 0666;
+            stbuf->st_nlink = 1;
+            return 0;
+        default:
+            break;
+    }
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
     
+    SCHEDULE_CALLBACK(STAT);
     try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        if (file.exits()) {
-            bool isDir = file.isDir();
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooResult<bool> exists = file.exits();
+        if (!exists.ok()) {
+            return zooError(context, exists);
+        }
+        if (exists.get()) {
+            bool isDir;
             if (context->getLeafMode() == LEAF_AS_DIR) {
                 // In LEAF_AS_DIR mode, override to make all nodes directories except the special data nodes
-                isDir = boost::filesystem::path(path).filename() != dataNodeName;
+                isDir = !ZookeeperFuseContext::isDataNode(path);
+            } else {
+                ZooResult<bool> dir = file.isDir();
+                if (!dir.ok()) {
+                    return zooError(context, dir);
+                }
+                isDir = dir.get();
             }
 
             if (isDir) {
@@ -209,23 +580,18 @@ static int getattr_callback(const char *path, struct stat *stbuf) {
                 stbuf->st_nlink = 2;
                 return 0;
             } else {
-                string content = file.getContent();
-                size_t length = content.length();
-                LOG(context, Logger::DEBUG, "Getting file size for: %s size: %d", getFullPath(path).c_str(), length);
+                ZooResult<size_t> length = file.getSize();
+                if (!length.ok()) {
+                    return zooError(context, length);
+                }
+                LOG(context, Logger::DEBUG, "Getting file size for: %s size: %d", getFullPath(path), length.get());
                 stbuf->st_mode = S_IFREG | 0777;
                 stbuf->st_nlink = 1;
-                stbuf->st_size = length;
+                stbuf->st_size = length.get();
                 return 0;
             }
         }
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        if (e.getErrorCode() == ZNOAUTH) {
-            return -EACCES;  
-        } else  {
-            return -EIO;
-        }
-    } catch (ZookeeperFuseContextException e) {
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
@@ -233,71 +599,141 @@ static int getattr_callback(const char *path, struct stat *stbuf) {
     return -ENOENT;
 }
 
-static int readdir_callback(const char *path, void *buf, fuse_fill_dir_t filler,
-        off_t offset, struct fuse_file_info *fi) {
-    callback_init("readdir_callback", path);
-    (void) offset;
-    (void) fi;
+static int listDirectory(const char *path, DirectoryListing &listing) {
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
 
-    filler(buf, ".", NULL, 0);
-    filler(buf, "..", NULL, 0);
-    filler(buf, dataNodeName.c_str(), NULL, 0);
+    SCHEDULE_CALLBACK(LIST);
     try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
 
-        vector<string> children = file.getChildren();
-        for (size_t i = 0; i < children.size(); i++) {
-            if (dataNodeName == children[i]) {
-                LOG(context, Logger::ERROR, "zookeeper-fuse error: cannot be used on a node which has a child node called %s", dataNodeName.c_str());
-                return -EIO;
-            }
-            filler(buf, children[i].c_str(), NULL, 0);
+        ZooResult<vector<string> > result = file.getChildren();
+        if (!result.ok()) {
+            return zooError(context, result);
         }
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        if (context->getPrefetcher()) {
+            context->getPrefetcher()->onReaddir(getFullPath(path), result.get());
+        }
+        listing.reset(result.get());
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
-  
+    if (listing.hasDataNodeChild()) {
+        LOG(context, Logger::ERROR, "zookeeper-fuse error: cannot be used on a node which has a child node called %s", dataNodeName.c_str());
+        return -EIO;
+    }
+    return 0;
+}
+
+// Listings are taken by the first readdir of an open directory, opendir itself does not contact the zoo
+static int opendir_callback(const char *path, struct fuse_file_info *fi) {
+    CALLBACK_INIT("opendir_callback", path);
+    TRACE_CALLBACK("opendir_callback", path);
+
+    string target;
+    fi->fh = 0;
+    if (getArchiveEntry(path, target) == ARCHIVE_NONE) {
+        fi->fh = reinterpret_cast<uint64_t>(new DirectoryListing(dataNodeName));
+    }
+    return 0;
+}
+
+static int releasedir_callback(const char *path, struct fuse_file_info *fi) {
+    CALLBACK_INIT("releasedir_callback", path);
+    TRACE_CALLBACK("releasedir_callback", path);
+    delete reinterpret_cast<DirectoryListing*>(fi->fh);
+    return 0;
+}
+
+static int readdir_callback(const char *path, void *buf, fuse_fill_dir_t filler,
+        off_t offset, struct fuse_file_info *fi) {
+    CALLBACK_INIT("readdir_callback", path);
+    TRACE_CALLBACK("readdir_callback", path);
+    RECORD_CALLBACK(OP_READDIR, path, offset);
+
+    string target;
+    if (getArchiveEntry(path, target) == ARCHIVE_DIRECTORY) {
+        filler(buf, ".", NULL, 0);
+        filler(buf, "..", NULL, 0);
+        if (path == archiveDir) {
+            filler(buf, "export", NULL, 0);
+            filler(buf, "import", NULL, 0);
+        }
+        return 0;
+    }
+
+    // Without an open directory the listing only lives for this call
+    auto_ptr<DirectoryListing> unopened;
+    DirectoryListing* listing = fi != NULL ? reinterpret_cast<DirectoryListing*>(fi->fh) : NULL;
+    if (listing == NULL) {
+        unopened.reset(new DirectoryListing(dataNodeName));
+        listing = unopened.get();
+    }
+    if (listing->needsListing(offset)) {
+        int rc = listDirectory(path, *listing);
+        if (rc != 0) {
+            return rc;
+        }
+    }
+
+    // Offsets are the index of the next entry, filling stops once the page handed in by the kernel is full
+    for (size_t i = offset; i < listing->getEntryCount(); i++) {
+        if (filler(buf, listing->getEntry(i), NULL, i + 1) != 0) {
+            break;
+        }
+    }
     return 0;
 }
 
 static int open_callback(const char *path, struct fuse_file_info *fi) {
-    callback_init("open_callback", path);
+    CALLBACK_INIT("open_callback", path);
+    TRACE_CALLBACK("open_callback", path);
+    RECORD_CALLBACK(OP_OPEN, path, 0, fi->flags);
+
+    string target;
+    ArchiveEntry entry = getArchiveEntry(path, target);
+    if (entry == ARCHIVE_EXPORT || entry == ARCHIVE_IMPORT) {
+        return openArchive(entry, target, fi);
+    }
+    openNode(path, fi);
     return 0;
 }
 
 static int read_callback(const char *path, char *buf, size_t size, off_t offset,
         struct fuse_file_info *fi) {
-    callback_init("read_callback", path);
-    string content;
+    CALLBACK_INIT("read_callback", path);
+    TRACE_CALLBACK("read_callback", path);
+    RECORD_CALLBACK(OP_READ, path, offset, size);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
-    
-    try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        content = file.getContent();
-    
-        LOG(context, Logger::DEBUG, "Reading from path: %s content: %s", getFullPath(path).c_str(), content.c_str());
 
-        ssize_t len = content.size();
-        if (offset >= len) {
+    FileHandle* archive = getArchiveHandle(fi);
+    if (archive != NULL) {
+        if (offset < 0 || static_cast<size_t>(offset) >= archive->content.length()) {
             return 0;
         }
-
-        ssize_t addr = offset + size;
-        if (addr > len) {
-            memcpy(buf, content.c_str() + offset, len - offset);
-            return len - offset;
+        size = std::min(size, archive->content.length() - offset);
+        memcpy(buf, archive->content.data() + offset, size);
+        return size;
+    }
+    FileHandle* handle = getFileHandle(fi);
+    if (handle != NULL) {
+        context->getPollRegistry().markRead(handle->seen);
+    }
+    
+    SCHEDULE_CALLBACK(READ);
+    try {
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        if (offset == 0 && context->getPrefetcher()) {
+            context->getPrefetcher()->onRead(getFullPath(path));
         }
-
-        memcpy(buf, content.c_str() + offset, size);
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        ZooResult<size_t> received = file.read(buf, size, offset);
+        if (!received.ok()) {
+            return zooError(context, received);
+        }
+        size = received.get();
+    
+        LOG(context, Logger::DEBUG, "Read from path: %s offset: %ld size: %lu", getFullPath(path), (long) offset, (unsigned long) size);
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
@@ -306,26 +742,42 @@ static int read_callback(const char *path, char *buf, size_t size, off_t offset,
 }
 
 int write_callback(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi) {
-    callback_init("write_callback", path);
-    string content;
-    string in = string(buf, size);
+    CALLBACK_INIT("write_callback", path);
+    TRACE_CALLBACK("write_callback", path);
+    RECORD_CALLBACK(OP_WRITE, path, offset, size);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    FileHandle* archive = getArchiveHandle(fi);
+    if (archive != NULL) {
+        if (archive->entry != ARCHIVE_IMPORT) {
+            return -EBADF;
+        }
+        // Archives are written front to back, a write past the end would leave a gap of zeroes to allocate
+        if (offset < 0 || static_cast<size_t>(offset) > archive->content.length()) {
+            LOG(context, Logger::ERROR, "Archive writes must be sequential, got offset %ld past %lu bytes",
+                (long) offset, (unsigned long) archive->content.length());
+            return -EINVAL;
+        }
+        if (archive->content.length() < offset + size) {
+            archive->content.resize(offset + size);
+        }
+        memcpy(&archive->content[offset], buf, size);
+        return size;
+    }
     
+    SCHEDULE_CALLBACK(WRITE);
     try {
         if (offset + size > context->getMaxFileSize()) {
             LOG(context, Logger::ERROR, "Attempting to write past maximum file size of %d", context->getMaxFileSize());
             return -EINVAL;
         }
 
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        content = file.getContent();
-        content.resize(offset + size);
-        content.replace(offset, size, in);
-        file.setContent(content);
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooStatus status = file.write(buf, size, offset);
+        if (!status.ok()) {
+            return zooError(context, status);
+        }
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
@@ -334,58 +786,96 @@ int write_callback(const char *path, const char *buf, size_t size, off_t offset,
 }
 
 int chmod_callback(const char *path, mode_t mode) {
-    callback_init("chmod_callback", path);
+    CALLBACK_INIT("chmod_callback", path);
+    TRACE_CALLBACK("chmod_callback", path);
+    RECORD_CALLBACK(OP_CHMOD, path, 0, mode);
     return 0;
 }
 
 int chown_callback(const char *path, uid_t uid, gid_t gid) {
-    callback_init("chown_callback", path);
+    CALLBACK_INIT("chown_callback", path);
+    TRACE_CALLBACK("chown_callback", path);
+    RECORD_CALLBACK(OP_CHOWN, path, uid, gid);
     return 0;
 }
 
 int utime_callback(const char *path, struct utimbuf *buf) { 
-    callback_init("utime_callback", path);
+    CALLBACK_INIT("utime_callback", path);
+    TRACE_CALLBACK("utime_callback", path);
+    RECORD_CALLBACK(OP_UTIME, path);
     return 0;
 }
 
 int create_callback(const char *path, mode_t mode, struct fuse_file_info *fi) {
-    callback_init("create_callback", path);
+    CALLBACK_INIT("create_callback", path);
+    TRACE_CALLBACK("create_callback", path);
+    RECORD_CALLBACK(OP_CREATE, path, 0, mode);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    string target;
+    switch (getArchiveEntry(path, target)) {
+        case ARCHIVE_IMPORT:
+            return openArchive(ARCHIVE_IMPORT, target, fi);
+        case ARCHIVE_NONE:
+            break;
+        default:
+            return -EACCES;
+    }
+
+    SCHEDULE_CALLBACK(WRITE);
     try {
         if (context->getLeafMode() == LEAF_AS_DIR) {
             LOG(context, Logger::ERROR, "File creation is only allowed via mkdir in LEAF_AS_DIR mode. Path: %s", path);
             return -ENOENT;
         }
 
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
 
-        if (!file.exits()) {
-            file.create();
+        ZooResult<bool> exists = file.exits();
+        if (!exists.ok()) {
+            return zooError(context, exists);
         }
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        if (!exists.get()) {
+            ZooStatus status = file.create();
+            if (!status.ok()) {
+                return zooError(context, status);
+            }
+        }
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
 
+    openNode(path, fi);
     return 0;  
 }
 
 int truncate_callback(const char *path, off_t size) {
-    callback_init("truncate_callback", path);
+    CALLBACK_INIT("truncate_callback", path);
+    TRACE_CALLBACK("truncate_callback", path);
+    RECORD_CALLBACK(OP_TRUNCATE, path, size);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    // Import files always start out empty
+    string target;
+    if (getArchiveEntry(path, target) != ARCHIVE_NONE) {
+        return 0;
+    }
     
+    SCHEDULE_CALLBACK(WRITE);
     try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        string content = file.getContent();
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        string content;
+        ZooStatus status = file.getContent(content);
+        if (!status.ok()) {
+            return zooError(context, status);
+        }
         content.resize(size);
-        file.setContent(content);
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        status = file.setContent(content);
+        if (!status.ok()) {
+            return zooError(context, status);
+        }
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
@@ -394,16 +884,19 @@ int truncate_callback(const char *path, off_t size) {
 }
 
 int unlink_callback(const char *path) {
-    callback_init("unlink_callback", path);
+    CALLBACK_INIT("unlink_callback", path);
+    TRACE_CALLBACK("unlink_callback", path);
+    RECORD_CALLBACK(OP_UNLINK, path);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
     
+    SCHEDULE_CALLBACK(WRITE);
     try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        file.remove();
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooStatus status = file.remove();
+        if (!status.ok()) {
+            return zooError(context, status);
+        }
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
@@ -412,21 +905,155 @@ int unlink_callback(const char *path) {
 }
 
 int mkdir_callback(const char* path, mode_t mode) {
-    callback_init("mkdir_callback", path);
+    CALLBACK_INIT("mkdir_callback", path);
+    TRACE_CALLBACK("mkdir_callback", path);
+    RECORD_CALLBACK(OP_MKDIR, path, 0, mode);
     ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
     
+    SCHEDULE_CALLBACK(WRITE);
     try {
-        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path));
-        if (!file.exits()) {
-            file.create();
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooResult<bool> exists = file.exits();
+        if (!exists.ok()) {
+            return zooError(context, exists);
         }
-    } catch (ZooFileException e) {
-        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
-        return -EIO;
-    } catch (ZookeeperFuseContextException e) {
+        if (!exists.get()) {
+            ZooStatus status = file.create();
+            if (!status.ok()) {
+                return zooError(context, status);
+            }
+        }
+    } catch (const ZookeeperFuseContextException &e) {
         LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
         return -EIO;
     }
 
     return 0;    
 }
+
+int fsync_callback(const char *path, int datasync, struct fuse_file_info *fi) {
+    CALLBACK_INIT("fsync_callback", path);
+    TRACE_CALLBACK("fsync_callback", path);
+    RECORD_CALLBACK(OP_FSYNC, path, 0, datasync);
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    SCHEDULE_CALLBACK(WRITE);
+    try {
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooStatus status = file.sync();
+        if (!status.ok()) {
+            return zooError(context, status);
+        }
+    } catch (const ZookeeperFuseContextException &e) {
+        LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
+        return -EIO;
+    }
+
+    return 0;
+}
+
+static int copyXattr(const string &value, char *buffer, size_t size) {
+    if (size == 0) {
+        return value.length();
+    }
+    if (size < value.length()) {
+        return -ERANGE;
+    }
+    memcpy(buffer, value.data(), value.length());
+    return value.length();
+}
+
+int getxattr_callback(const char *path, const char *name, char *value, size_t size) {
+    CALLBACK_INIT("getxattr_callback", path);
+    TRACE_CALLBACK("getxattr_callback", path);
+    RECORD_CALLBACK(OP_GETXATTR, path, 0, size, name);
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    SCHEDULE_CALLBACK(STAT);
+    try {
+        // A single exists call, the contents of the node are not transferred
+        ZooFile file(ZookeeperFuseContext::getZookeeperHandle(fuse_get_context()), getFullPath(path), context->getFileOptions());
+        ZooResult<Stat> stat = file.getStat();
+        if (!stat.ok()) {
+            return zooError(context, stat);
+        }
+        string attribute;
+        if (!StatAttributes::get(stat.get(), name, attribute)) {
+            return -ENODATA;
+        }
+        return copyXattr(attribute, value, size);
+    } catch (const ZookeeperFuseContextException &e) {
+        LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
+        return -EIO;
+    }
+}
+
+int listxattr_callback(const char *path, char *list, size_t size) {
+    CALLBACK_INIT("listxattr_callback", path);
+    TRACE_CALLBACK("listxattr_callback", path);
+    RECORD_CALLBACK(OP_LISTXATTR, path, 0, size);
+    return copyXattr(StatAttributes::list(), list, size);
+}
+
+// Imports run when the file is closed, so that a failure is reported by close
+int flush_callback(const char *path, struct fuse_file_info *fi) {
+    CALLBACK_INIT("flush_callback", path);
+    TRACE_CALLBACK("flush_callback", path);
+    RECORD_CALLBACK(OP_FLUSH, path);
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    FileHandle* archive = getArchiveHandle(fi);
+    if (archive == NULL || archive->entry != ARCHIVE_IMPORT || archive->imported || archive->content.empty()) {
+        return 0;
+    }
+
+    try {
+        size_t count = context->getArchive().importTree(archive->zooPath, archive->content);
+        archive->imported = true;
+        LOG(context, Logger::INFO, "Imported %lu nodes at %s", (unsigned long) count, archive->zooPath.c_str());
+    } catch (const ZooFileException &e) {
+        LOG(context, Logger::ERROR, "Zookeeper Error: %d", e.getErrorCode());
+        return -zooErrno(e.getErrorCode());
+    }
+    return 0;
+}
+
+int release_callback(const char *path, struct fuse_file_info *fi) {
+    CALLBACK_INIT("release_callback", path);
+    TRACE_CALLBACK("release_callback", path);
+    RECORD_CALLBACK(OP_RELEASE, path);
+    FileHandle* handle = getFileHandle(fi);
+    if (handle != NULL) {
+        ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context())->getPollRegistry().detach(handle->polled);
+    }
+    delete handle;
+    return 0;
+}
+
+// Waits for the node to change, files read as POLLIN once it did since their last read
+int poll_callback(const char *path, struct fuse_file_info *fi, struct fuse_pollhandle *ph, unsigned *reventsp) {
+    CALLBACK_INIT("poll_callback", path);
+    TRACE_CALLBACK("poll_callback", path);
+    ZookeeperFuseContext* context = ZookeeperFuseContext::getZookeeperFuseContext(fuse_get_context());
+
+    FileHandle* handle = getFileHandle(fi);
+    if (handle == NULL || handle->entry != ARCHIVE_NONE) {
+        if (ph != NULL) {
+            fuse_pollhandle_destroy(ph);
+        }
+        *reventsp = POLLIN | POLLRDNORM | POLLOUT | POLLWRNORM;
+        return 0;
+    }
+
+    try {
+        zhandle_t* zh = ZookeeperFuseContext::getZookeeperHandle(fuse_get_context());
+        *reventsp = context->getPollRegistry().poll(zh, handle->zooPath, handle->seen, handle->polled, ph);
+    } catch (const ZookeeperFuseContextException &e) {
+        LOG(context, Logger::ERROR, "Zookeeper Fuse Context Error: %d", e.getErrorCode());
+        if (ph != NULL) {
+            fuse_pollhandle_destroy(ph);
+        }
+        return -EIO;
+    }
+    return 0;
+}
@@ -22,26 +22,93 @@
 #include <iostream>
 #include <errno.h>
 #include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
 
 #include "ZookeeperFuseContext.h"
 #include "logger/Logger.h"
 #include "logger/Log4CPPLogger.h"
 
+const char ZookeeperFuseContext::DATA_NODE_NAME[] = "_zoo_data_";
+
 ZookeeperFuseContext::ZookeeperFuseContext(Logger::LogLevel maxLevel, const string &hosts, const string &authScheme, const string &auth, const string &path, LeafMode leafMode, size_t maxFileSize):
-hosts_(hosts), authSheme_(authScheme), auth_(auth), path_(path), handle_(NULL), leafMode_(leafMode), maxFileSize_(maxFileSize), eventQueue_(8) {
+hosts_(hosts), authSheme_(authScheme), auth_(auth), path_(path), handle_(NULL), sessionState_(0), owner_(NULL), leafMode_(leafMode), maxFileSize_(maxFileSize), eventQueue_(8) {
+    fileOptions_.maxContentSize = maxFileSize;
 #ifdef HAVE_LOG4CPP
     logger_.reset(new Log4CPPLogger(maxLevel));
 #else
     logger_.reset(new Logger(maxLevel));
 #endif
+    archive_.reset(new SubtreeArchive(this));
+    pollRegistry_.reset(new PollRegistry());
 }
 
 ZookeeperFuseContext::~ZookeeperFuseContext() {
+    closeZookeeperHandle();
+
+    if (singleFlight_.get()) {
+        logger_->log(Logger::INFO, "Read coalescing: %lu requests sent, %lu saved",
+                     (unsigned long) singleFlight_->getIssued(), (unsigned long) singleFlight_->getCoalesced());
+    }
+    if (prefetcher_.get()) {
+        logger_->log(Logger::INFO, "Prefetch: %lu fetches, %lu scans cancelled, cache %lu hits, %lu misses",
+                     (unsigned long) prefetcher_->getIssued(), (unsigned long) prefetcher_->getCancelled(),
+                     (unsigned long) contentCache_->getHits(), (unsigned long) contentCache_->getMisses());
+        logger_->log(Logger::INFO, "Content cache: %lu nodes in %lu bytes",
+                     (unsigned long) contentCache_->getNodeCount(), (unsigned long) contentCache_->getMemoryUsage());
+    }
+    if (hedgedReads_.get()) {
+        logger_->log(Logger::INFO, "Hedged reads: %lu hedges sent, %lu won, %lu deadlines missed, %lu answered stale",
+                     (unsigned long) hedgedReads_->getHedged(), (unsigned long) hedgedReads_->getHedgeWins(),
+                     (unsigned long) hedgedReads_->getTimeouts(), (unsigned long) hedgedReads_->getStaleServed());
+    }
+    if (scheduler_.get()) {
+        string throttled;
+        for (size_t i = 0; i < RequestScheduler::CLASS_COUNT; i++) {
+            RequestScheduler::OpClass opClass = static_cast<RequestScheduler::OpClass>(i);
+            char count[64];
+            snprintf(count, sizeof(count), "%s%s %lu", i > 0 ? ", " : "", RequestScheduler::classToString(opClass),
+                     (unsigned long) scheduler_->getThrottled(opClass));
+            throttled += count;
+        }
+        logger_->log(Logger::INFO, "Scheduling: %lu requests admitted, %lu of them bulk, at most %lu queued, throttled %s",
+                     (unsigned long) scheduler_->getAdmitted(), (unsigned long) scheduler_->getBulkAdmitted(),
+                     (unsigned long) scheduler_->getMaxQueued(), throttled.c_str());
+    }
+    if (pollRegistry_->getWakeups() > 0) {
+        logger_->log(Logger::INFO, "Poll: %lu waiters woken by node changes", (unsigned long) pollRegistry_->getWakeups());
+    }
+    if (tracer_.get()) {
+        logger_->log(Logger::INFO, "Trace: %lu spans dropped by full thread buffers", (unsigned long) tracer_->getDropped());
+    }
+    if (recorder_.get()) {
+        logger_->log(Logger::INFO, "Record: %lu operations captured", (unsigned long) recorder_->getCount());
+    }
+}
+
+void ZookeeperFuseContext::closeZookeeperHandle() {
+    if (owner_ != NULL) {
+        return;
+    }
+
+    // Deferred writes need the session to land
+    if (writeBehind_.get()) {
+        logger_->log(Logger::INFO, "Write behind: %lu writes sent as %lu updates",
+                     (unsigned long) writeBehind_->getWrites(), (unsigned long) writeBehind_->getFlushes());
+        fileOptions_.writeBehind = NULL;
+        writeBehind_.reset();
+    }
+
+    if (serverSelector_.get()) {
+        serverSelector_->stop();
+    }
     if (handle_ != NULL) {
         int rc = zookeeper_close(handle_);
         if (rc != ZOK) {
             cerr << "An error occurred freeing the zookeeper handle." << endl;
         }
+        handle_ = NULL;
     }
 }
 
@@ -51,9 +118,24 @@ static void zkWatcher(zhandle_t *zh, int type, int state, const char *path, void
     // This is probably not thread-safe!
     cout << "In zkWatcher for handle: " << zh << " type: " << type << " state: " << state << endl;
     ZookeeperFuseContext* context = reinterpret_cast<ZookeeperFuseContext*>(watcherCtx);
+    if (type == ZOO_SESSION_EVENT) {
+        context->onSessionState(state);
+    }
     context->fireConnectedEvent();
 }
 
+void ZookeeperFuseContext::onSessionState(int state) {
+    if (state == sessionState_) {
+        return;
+    }
+    if (state == ZOO_READONLY_STATE) {
+        logger_->log(Logger::WARNING, "Connected to a server without quorum, writes fail with EROFS until it returns");
+    } else if (state == ZOO_CONNECTED_STATE && sessionState_ == ZOO_READONLY_STATE) {
+        logger_->log(Logger::INFO, "Quorum is back, the session is writable again");
+    }
+    sessionState_ = state;
+}
+
 void ZookeeperFuseContext::fireConnectedEvent() {
     eventQueue_.push('c');
 }
@@ -62,9 +144,20 @@ Logger& ZookeeperFuseContext::getLogger() {
     return *logger_;
 }
 
+void ZookeeperFuseContext::shareSession(ZookeeperFuseContext* owner) {
+    owner_ = owner;
+    fileOptions_ = owner->getFileOptions();
+    fileOptions_.maxContentSize = maxFileSize_;
+}
+
 zhandle_t* ZookeeperFuseContext::getZookeeperHandle() {
+    if (owner_ != NULL) {
+        return owner_->getZookeeperHandle();
+    }
     if (!handle_) {
-        handle_ = zookeeper_init(hosts_.c_str(), zkWatcher, 10, NULL, this, 0);
+        TraceSpan span(tracer_.get(), "connect", hosts_.c_str());
+        string hosts = serverSelector_.get() ? serverSelector_->select() : hosts_;
+        handle_ = zookeeper_init(hosts.c_str(), zkWatcher, 10, NULL, this, fileOptions_.allowReadOnly ? ZOO_READONLY : 0);
         if (handle_ == NULL) {
             cerr << "Failed to create zookeeper handle with error: " << errno << endl;
             return NULL;
@@ -84,6 +177,9 @@ zhandle_t* ZookeeperFuseContext::getZookeeperHandle() {
             cout << "Waiting for the zookeeper connection to be established." << endl;
             sleep(1);
         }
+        if (serverSelector_.get()) {
+            serverSelector_->monitor(handle_);
+        }
     }
     return handle_;
 }
@@ -96,6 +192,61 @@ void ZookeeperFuseContext::setPath(const string &path) {
     path_ = path;
 }
 
+size_t ZookeeperFuseContext::splitPath(const char *path, size_t &pathLength) const {
+    // Avoid duplicate "/" issues at the start of paths
+    size_t rootLength = path_ == "/" ? 0 : path_.length();
+
+    pathLength = strlen(path);
+    if (isDataNode(path)) {
+        // The data node stands for its parent, the root when it is at the top
+        const char *slash = strrchr(path, '/');
+        pathLength = slash == NULL ? 0 : std::max<size_t>(slash - path, 1);
+    }
+
+    // Must avoid ending the path in "/" unless we are looking at the root, zookeeper is picky
+    if (rootLength + pathLength > 1) {
+        if (pathLength > 0 && path[pathLength - 1] == '/') {
+            pathLength--;
+        } else if (pathLength == 0 && path_[rootLength - 1] == '/') {
+            rootLength--;
+        }
+    }
+    return rootLength;
+}
+
+string ZookeeperFuseContext::resolvePath(const string &path) {
+    size_t pathLength;
+    size_t rootLength = splitPath(path.c_str(), pathLength);
+
+    string retval;
+    retval.reserve(rootLength + pathLength);
+    retval.append(path_, 0, rootLength);
+    retval.append(path, 0, pathLength);
+    logger_->log(Logger::DEBUG, "Requesting node: %s for path: %s", retval.c_str(), path.c_str());
+    return retval;
+}
+
+const char* ZookeeperFuseContext::resolvePath(const char *path, RequestArena &arena) {
+    size_t pathLength;
+    size_t rootLength = splitPath(path, pathLength);
+
+    char* retval = static_cast<char*>(arena.allocate(rootLength + pathLength + 1));
+    memcpy(retval, path_.data(), rootLength);
+    memcpy(retval + rootLength, path, pathLength);
+    retval[rootLength + pathLength] = '\0';
+    logger_->log(Logger::DEBUG, "Requesting node: %s for path: %s", retval, path);
+    return retval;
+}
+
+bool ZookeeperFuseContext::isDataNode(const string &path) {
+    return isDataNode(path.c_str());
+}
+
+bool ZookeeperFuseContext::isDataNode(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return strcmp(slash != NULL ? slash + 1 : path, DATA_NODE_NAME) == 0;
+}
+
 LeafMode ZookeeperFuseContext::getLeafMode() const {
     return leafMode_;
 }
@@ -110,6 +261,119 @@ size_t ZookeeperFuseContext::getMaxFileSize() const {
 
 void ZookeeperFuseContext::setMaxFileSize(size_t maxFileSize) {
     maxFileSize_ = maxFileSize;
+    fileOptions_.maxContentSize = maxFileSize;
+}
+
+bool ZookeeperFuseContext::setCompression(Codec::Type type, size_t threshold) {
+    Codec* codec = NULL;
+    if (type != Codec::NONE) {
+        codec = Codec::create(type);
+        if (codec == NULL) {
+            return false;
+        }
+    }
+    codec_.reset(codec);
+    fileOptions_.codec = codec_.get();
+    fileOptions_.compressionThreshold = threshold;
+    return true;
+}
+
+void ZookeeperFuseContext::setChunking(size_t chunkSize, size_t chunkConcurrency) {
+    fileOptions_.chunkSize = chunkSize;
+    fileOptions_.chunkConcurrency = chunkConcurrency;
+}
+
+void ZookeeperFuseContext::setCoalesceReads(bool coalesce) {
+    singleFlight_.reset(coalesce ? new SingleFlight() : NULL);
+    fileOptions_.singleFlight = singleFlight_.get();
+}
+
+void ZookeeperFuseContext::setWriteBehind(unsigned int windowMillis) {
+    fileOptions_.writeBehind = NULL;
+    writeBehind_.reset(windowMillis > 0 ? new WriteBehindQueue(this, windowMillis) : NULL);
+    fileOptions_.writeBehind = writeBehind_.get();
+}
+
+void ZookeeperFuseContext::setPrefetch(size_t budget) {
+    fileOptions_.cache = NULL;
+    prefetcher_.reset();
+    contentCache_.reset(budget > 0 ? new ContentCache(budget) : NULL);
+    if (contentCache_.get()) {
+        prefetcher_.reset(new Prefetcher(this, contentCache_.get()));
+    }
+    fileOptions_.cache = contentCache_.get();
+}
+
+void ZookeeperFuseContext::setAllowReadOnly(bool allow) {
+    fileOptions_.allowReadOnly = allow;
+}
+
+void ZookeeperFuseContext::setServerSelection(bool nearest) {
+    serverSelector_.reset(nearest ? new ServerSelector(hosts_, *logger_) : NULL);
+}
+
+void ZookeeperFuseContext::setHedgedReads(unsigned int deadlineMillis, bool hedge, bool serveStale) {
+    fileOptions_.hedgedReads = NULL;
+    hedgedReads_.reset(deadlineMillis > 0 || hedge ?
+                       new HedgedReads(hosts_, authSheme_, auth_, deadlineMillis, hedge, serveStale) : NULL);
+    fileOptions_.hedgedReads = hedgedReads_.get();
+}
+
+void ZookeeperFuseContext::setScheduling(const double rates[RequestScheduler::CLASS_COUNT], size_t maxOutstanding,
+                                         const set<uid_t> &bulkUids, unsigned int scanRate) {
+    bool limited = maxOutstanding > 0;
+    for (size_t i = 0; i < RequestScheduler::CLASS_COUNT; i++) {
+        limited = limited || rates[i] > 0;
+    }
+    scheduler_.reset(limited ? new RequestScheduler(rates, maxOutstanding, bulkUids, scanRate) : NULL);
+}
+
+RequestScheduler* ZookeeperFuseContext::getScheduler() {
+    return owner_ != NULL ? owner_->getScheduler() : scheduler_.get();
+}
+
+Prefetcher* ZookeeperFuseContext::getPrefetcher() {
+    return owner_ != NULL ? owner_->getPrefetcher() : prefetcher_.get();
+}
+
+void ZookeeperFuseContext::setTrace(const string &file, unsigned int sampleRate, size_t windowSize) {
+    fileOptions_.tracer = NULL;
+    tracer_.reset(file.empty() ? NULL : new Tracer(file, sampleRate, windowSize));
+    fileOptions_.tracer = tracer_.get();
+}
+
+Tracer* ZookeeperFuseContext::getTracer() {
+    return owner_ != NULL ? owner_->getTracer() : tracer_.get();
+}
+
+bool ZookeeperFuseContext::setRecord(const string &file) {
+    recorder_.reset();
+    if (file.empty()) {
+        return true;
+    }
+    try {
+        recorder_.reset(new WorkloadRecorder(file));
+    } catch (const WorkloadTraceException &e) {
+        logger_->log(Logger::ERROR, "%s", e.what());
+        return false;
+    }
+    return true;
+}
+
+WorkloadRecorder* ZookeeperFuseContext::getRecorder() {
+    return owner_ != NULL ? owner_->getRecorder() : recorder_.get();
+}
+
+SubtreeArchive& ZookeeperFuseContext::getArchive() {
+    return *archive_;
+}
+
+PollRegistry& ZookeeperFuseContext::getPollRegistry() {
+    return owner_ != NULL ? owner_->getPollRegistry() : *pollRegistry_;
+}
+
+const ZooFileOptions& ZookeeperFuseContext::getFileOptions() const {
+    return fileOptions_;
 }
 
 ZookeeperFuseContext* ZookeeperFuseContext::getZookeeperFuseContext(fuse_context* context) {
@@ -30,6 +30,19 @@
 #include <boost/shared_ptr.hpp>
 
 #include "logger/Logger.h"
+#include "codec/Codec.h"
+#include "ZooFile.h"
+#include "WriteBehindQueue.h"
+#include "ContentCache.h"
+#include "Prefetcher.h"
+#include "SubtreeArchive.h"
+#include "Tracer.h"
+#include "WorkloadTrace.h"
+#include "HedgedReads.h"
+#include "ServerSelector.h"
+#include "PollRegistry.h"
+#include "RequestScheduler.h"
+#include "RequestArena.h"
 
 using namespace std;
 using namespace boost;
@@ -66,6 +79,9 @@ private:
 
 class ZookeeperFuseContext {
 public:
+    // Name of the special file exposing the contents of a node which is displayed as a directory
+    static const char DATA_NODE_NAME[];
+
     ZookeeperFuseContext(Logger::LogLevel maxLevel, const string &hosts, const string &authScheme, const string &auth, const string &path, 
                          LeafMode leafMode, size_t maxFileSize);
     virtual ~ZookeeperFuseContext();
@@ -73,17 +89,70 @@ public:
     Logger& getLogger();
 
     zhandle_t* getZookeeperHandle();
+    void closeZookeeperHandle();
+
+    // Serves this mount through the session, caches, poll watches and tracing of owner, which must be configured
+    // already and outlive this context. The root path, leaf mode and file size limit stay those of this context
+    void shareSession(ZookeeperFuseContext* owner);
     
     string getPath() const;
     void setPath(const string &path);    
 
+    // Maps a path within the mount to the path of the node in the zoo
+    string resolvePath(const string &path);
+    // Same, kept in the arena until the callback returns
+    const char* resolvePath(const char *path, RequestArena &arena);
+    static bool isDataNode(const string &path);
+    static bool isDataNode(const char *path);
+
     LeafMode getLeafMode() const;
     void setLeafMode(LeafMode leafMode);
 
     size_t getMaxFileSize() const;
     void setMaxFileSize(size_t maxFileSize);
+
+    // Returns false if the requested codec was not compiled in
+    bool setCompression(Codec::Type type, size_t threshold);
+
+    void setChunking(size_t chunkSize, size_t chunkConcurrency);
+    void setCoalesceReads(bool coalesce);
+    // Defers content updates by the given window, 0 writes through
+    void setWriteBehind(unsigned int windowMillis);
+    // Caches up to budget bytes of contents, filled ahead of directory scans, 0 disables
+    void setPrefetch(size_t budget);
+    // Lets the session connect to servers cut off from the quorum, serving reads only until it returns
+    void setAllowReadOnly(bool allow);
+    // Opens the session on the nearest servers found by probing, moving it when they fail or recover
+    void setServerSelection(bool nearest);
+    // Fails reads after deadlineMillis, or answers them with the last answer seen when serveStale is set,
+    // hedge re-sends reads slower than the p95 on a second session. A 0 deadline without hedging disables
+    void setHedgedReads(unsigned int deadlineMillis, bool hedge, bool serveStale);
+    // Rate limits requests by class and caps those outstanding on the session, favouring interactive callers
+    // over bulk ones. Without rates or a cap it is disabled
+    void setScheduling(const double rates[RequestScheduler::CLASS_COUNT], size_t maxOutstanding, const set<uid_t> &bulkUids,
+                       unsigned int scanRate);
+
+    // NULL unless prefetching is enabled
+    Prefetcher* getPrefetcher();
+    SubtreeArchive& getArchive();
+    PollRegistry& getPollRegistry();
+    // NULL unless scheduling is enabled
+    RequestScheduler* getScheduler();
+
+    // Writes traces of one in sampleRate callbacks to file, an empty file disables tracing
+    void setTrace(const string &file, unsigned int sampleRate, size_t windowSize);
+    // NULL unless tracing is enabled
+    Tracer* getTracer();
+
+    // Captures every callback to file for replay, an empty file disables capture. Returns false if the file can not be created
+    bool setRecord(const string &file);
+    // NULL unless capture is enabled
+    WorkloadRecorder* getRecorder();
+
+    const ZooFileOptions& getFileOptions() const;
    
     void fireConnectedEvent();
+    void onSessionState(int state);
  
     static ZookeeperFuseContext* getZookeeperFuseContext(fuse_context* context);
     static zhandle_t* getZookeeperHandle(fuse_context* context);
@@ -91,6 +160,9 @@ public:
 private:
     ZookeeperFuseContext(const ZookeeperFuseContext& orig);
     ZookeeperFuseContext& operator=(const ZookeeperFuseContext &rhs);
+
+    // Length of the root path and of the part of path making up the zoo path
+    size_t splitPath(const char *path, size_t &pathLength) const;
     
     string hosts_;
     string authSheme_;
@@ -99,8 +171,25 @@ private:
     LeafMode leafMode_;
     size_t maxFileSize_;
     zhandle_t* handle_;
+    int sessionState_;
+    // Set when the session belongs to another mount
+    ZookeeperFuseContext* owner_;
     boost::lockfree::queue<char> eventQueue_;
     auto_ptr<Logger> logger_;
+    // Declared early so that it outlives everything it traces
+    auto_ptr<Tracer> tracer_;
+    auto_ptr<WorkloadRecorder> recorder_;
+    auto_ptr<Codec> codec_;
+    auto_ptr<SingleFlight> singleFlight_;
+    auto_ptr<WriteBehindQueue> writeBehind_;
+    auto_ptr<ContentCache> contentCache_;
+    auto_ptr<Prefetcher> prefetcher_;
+    auto_ptr<SubtreeArchive> archive_;
+    auto_ptr<PollRegistry> pollRegistry_;
+    auto_ptr<HedgedReads> hedgedReads_;
+    auto_ptr<ServerSelector> serverSelector_;
+    auto_ptr<RequestScheduler> scheduler_;
+    ZooFileOptions fileOptions_;
 };
 
 #endif	/* ZOOCONTEXT_H */
@@ -0,0 +1,1068 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZookeeperFuseLowLevel.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 2:05 PM
+ */
+#define FUSE_USE_VERSION 26
+
+#include <fuse_lowlevel.h>
+#include <zookeeper/zookeeper.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ZooFile.h"
+#include "InodeTable.h"
+#include "DirectoryListing.h"
+#include "InFlightLimiter.h"
+#include "InvalidationNotifier.h"
+#include "RequestScheduler.h"
+#include "StatAttributes.h"
+#include "Tracer.h"
+#include "WriteBehindQueue.h"
+#include "ZookeeperFuseLowLevel.h"
+
+using namespace std;
+
+#define LOG(context, level, msg, ...) \
+    context->getLogger().log(level, msg, __VA_ARGS__)
+
+// Attributes and entries are invalidated by watches, the timeouts only bound how long a missed event lingers
+static const double ATTR_TIMEOUT = 1.0;
+static const double ENTRY_TIMEOUT = 1.0;
+
+struct LowLevelFs {
+    LowLevelFs(ZookeeperFuseContext* context, size_t maxInFlight) :
+    context(context), inodes(context->resolvePath("/")),
+    limiter(maxInFlight > 0 ? new InFlightLimiter(maxInFlight) : NULL) {
+
+    }
+
+    ZookeeperFuseContext* context;
+    InodeTable inodes;
+    InvalidationNotifier notifier;
+    // Set when requests are answered from zookeeper completions instead of blocking the fuse workers
+    auto_ptr<InFlightLimiter> limiter;
+};
+
+// Kept in fuse_file_info::fh of open files
+struct OpenFile {
+    // Generation of the node the file last read and the node it polls, see PollRegistry
+    uint64_t seen;
+    string polled;
+};
+
+static LowLevelFs* getFs(fuse_req_t req) {
+    return reinterpret_cast<LowLevelFs*>(fuse_req_userdata(req));
+}
+
+// Admission of a request answered on the fuse worker, see RequestScheduler
+#define SCHEDULE_REQUEST(fs, req, opClass) \
+    Admission admission((fs)->context->getScheduler(), RequestScheduler::opClass, fuse_req_ctx(req)->pid, fuse_req_ctx(req)->uid)
+
+static string childPath(const string &parent, const char *name) {
+    return parent == "/" ? parent + name : parent + "/" + name;
+}
+
+static string parentPath(const string &path, string &name) {
+    size_t slash = path.rfind('/');
+    name = path.substr(slash + 1);
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+static int zooError(LowLevelFs* fs, const ZooStatus &status) {
+    LOG(fs->context, Logger::ERROR, "Zookeeper Error: %d while %s", status.getErrorCode(), status.getAction());
+    return status.getErrno();
+}
+
+static void nodeWatcher(zhandle_t *zh, int type, int state, const char *path, void *watcherCtx) {
+    LowLevelFs* fs = reinterpret_cast<LowLevelFs*>(watcherCtx);
+
+    if (type == ZOO_SESSION_EVENT) {
+        if (state == ZOO_EXPIRED_SESSION_STATE) {
+            // Every watch went with the session, nothing cached can be trusted anymore
+            fs->inodes.invalidateAll();
+        }
+        return;
+    }
+
+    LOG(fs->context, Logger::DEBUG, "Watch fired for node: %s type: %d", path, type);
+    vector<uint64_t> inodes = fs->inodes.invalidate(path);
+    for (size_t i = 0; i < inodes.size(); i++) {
+        fs->notifier.invalidateInode(inodes[i]);
+
+        string mountPath;
+        string zooPath;
+        if (type == ZOO_DELETED_EVENT && fs->inodes.getPath(inodes[i], mountPath, zooPath) && mountPath != "/") {
+            string name;
+            uint64_t parent = fs->inodes.find(parentPath(mountPath, name));
+            if (parent != 0) {
+                fs->notifier.invalidateEntry(parent, name);
+            }
+        }
+    }
+}
+
+// Deferred writes, cached contents, read deadlines and failing fast while disconnected only live in ZooFile,
+// reads needing them are served synchronously
+static bool canDispatchAsync(LowLevelFs* fs, const string &zooPath) {
+    const ZooFileOptions &options = fs->context->getFileOptions();
+    if (fs->limiter.get() == NULL || options.hedgedReads != NULL) {
+        return false;
+    }
+    if (options.allowReadOnly) {
+        // Requests would wait on the session during quorum loss, ZooFile fails them at once instead
+        zhandle_t* handle = fs->context->getZookeeperHandle();
+        int state = handle != NULL ? zoo_state(handle) : 0;
+        if (state != ZOO_CONNECTED_STATE && state != ZOO_READONLY_STATE) {
+            return false;
+        }
+    }
+    return (options.writeBehind == NULL || !options.writeBehind->contains(zooPath)) &&
+           (options.cache == NULL || !options.cache->contains(zooPath));
+}
+
+static ZooFile* openFile(LowLevelFs* fs, const string &zooPath) {
+    ZooFile* file = new ZooFile(fs->context->getZookeeperHandle(), zooPath, fs->context->getFileOptions());
+    file->setWatcher(nodeWatcher, fs);
+    return file;
+}
+
+/*
+ * Mirrors getattr_callback of the high level api, but only computes what the leaf mode needs
+ */
+static int getAttributes(LowLevelFs* fs, uint64_t inode, const string &path, const string &zooPath, struct stat *stbuf,
+                         Stat *zooStat = NULL, bool *cacheable = NULL) {
+    Stat localStat;
+    if (zooStat == NULL) {
+        zooStat = &localStat;
+    }
+    if (inode != 0 && fs->inodes.getAttributes(inode, *stbuf, zooStat)) {
+        return 0;
+    }
+
+    memset(stbuf, 0, sizeof(struct stat));
+    if (fs->context->getZookeeperHandle() == NULL) {
+        return -EIO;
+    }
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    // Lookups mostly probe names which do not exist, an exists would leave a watch behind on every one of
+    // them. A get leaves none on a missing node and gives the size of files as well
+    ZooResult<size_t> length(static_cast<size_t>(0));
+    if (inode == 0) {
+        length = file->getSize();
+        if (length.getErrorCode() == ZNONODE) {
+            return -ENOENT;
+        }
+        if (!length.ok()) {
+            return -zooError(fs, length);
+        }
+    } else {
+        ZooResult<bool> exists = file->exits();
+        if (!exists.ok()) {
+            return -zooError(fs, exists);
+        }
+        if (!exists.get()) {
+            return -ENOENT;
+        }
+    }
+
+    bool isDir;
+    if (fs->context->getLeafMode() == LEAF_AS_DIR) {
+        isDir = !ZookeeperFuseContext::isDataNode(path);
+    } else {
+        ZooResult<bool> dir = file->isDir();
+        if (!dir.ok()) {
+            return -zooError(fs, dir);
+        }
+        isDir = dir.get();
+    }
+
+    if (isDir) {
+        stbuf->st_mode = S_IFDIR | 0755;
+        stbuf->st_nlink = 2;
+    } else {
+        if (inode != 0) {
+            length = file->getSize();
+            if (!length.ok()) {
+                return -zooError(fs, length);
+            }
+        }
+        stbuf->st_mode = S_IFREG | 0777;
+        stbuf->st_nlink = 1;
+        stbuf->st_size = length.get();
+    }
+    stbuf->st_ino = inode;
+    ZooResult<Stat> stat = file->getStat();
+    if (!stat.ok()) {
+        return -zooError(fs, stat);
+    }
+    *zooStat = stat.get();
+
+    // Hedged and stale answers may be older than the watch, which would then never drop them
+    if (inode != 0 && file->isCoveredByWatch()) {
+        fs->inodes.setAttributes(inode, *stbuf, *zooStat);
+    }
+    if (cacheable != NULL) {
+        *cacheable = file->isCoveredByWatch();
+    }
+    return 0;
+}
+
+static bool resolveInode(fuse_req_t req, fuse_ino_t ino, string &path, string &zooPath) {
+    if (!getFs(req)->inodes.getPath(ino, path, zooPath)) {
+        fuse_reply_err(req, ESTALE);
+        return false;
+    }
+    return true;
+}
+
+static void replyEntry(fuse_req_t req, const string &path, const string &zooPath) {
+    LowLevelFs* fs = getFs(req);
+    struct fuse_entry_param entry;
+    memset(&entry, 0, sizeof(entry));
+
+    Stat zooStat;
+    bool cacheable = false;
+    int rc = getAttributes(fs, 0, path, zooPath, &entry.attr, &zooStat, &cacheable);
+    if (rc != 0) {
+        fuse_reply_err(req, -rc);
+        return;
+    }
+
+    entry.ino = fs->inodes.lookup(path, zooPath);
+    entry.attr.st_ino = entry.ino;
+    entry.attr_timeout = ATTR_TIMEOUT;
+    entry.entry_timeout = ENTRY_TIMEOUT;
+    if (cacheable) {
+        fs->inodes.setAttributes(entry.ino, entry.attr, zooStat);
+    }
+    if (fuse_reply_entry(req, &entry) != 0) {
+        // The kernel never saw the entry, so it will never forget it either
+        fs->inodes.forget(entry.ino, 1);
+    }
+}
+
+// Fills one page of at most size bytes from the snapshot, offsets handed to the kernel are the index of the next entry
+static void replyDirectory(fuse_req_t req, DirectoryListing &listing, size_t size, off_t off) {
+    vector<char> buffer(size);
+    size_t used = 0;
+    struct stat stbuf;
+    memset(&stbuf, 0, sizeof(stbuf));
+    for (size_t i = off; i < listing.getEntryCount(); i++) {
+        size_t needed = fuse_add_direntry(req, &buffer[used], size - used, listing.getEntry(i), &stbuf, i + 1);
+        if (needed > size - used) {
+            break;
+        }
+        used += needed;
+    }
+    fuse_reply_buf(req, used > 0 ? &buffer[0] : NULL, used);
+}
+
+/*
+ * Asynchronous dispatch
+ *
+ * The callbacks below only start a zookeeper operation and return, the reply to the kernel is sent from
+ * the completion. Completions are delivered one at a time on the zookeeper completion thread, which must
+ * never block, so everything past the first request (including chunk fetches) is chained asynchronously.
+ * Each fuse request holds one limiter slot, and its scheduler admission if any, from dispatch until its reply.
+ */
+struct AsyncRequest {
+    enum Kind {
+        LOOKUP,
+        GETATTR,
+        READ,
+        READDIR
+    };
+
+    AsyncRequest(fuse_req_t req, LowLevelFs* fs, Kind kind) :
+    req(req), fs(fs), kind(kind), inode(0), size(0), offset(0), listing(NULL), first(0), next(0), pending(0), rc(ZOK),
+    traceStart(0) {
+
+    }
+
+    fuse_req_t req;
+    LowLevelFs* fs;
+    Kind kind;
+    uint64_t inode;
+    string path;
+    string zooPath;
+    size_t size;
+    off_t offset;
+    // Snapshot of the open directory a readdir refreshes
+    DirectoryListing* listing;
+
+    // State of a chunked read
+    ChunkManifest manifest;
+    uint32_t first;
+    uint32_t next;
+    size_t pending;
+    int rc;
+    vector<string> chunks;
+
+    // Start of the span from dispatch to reply, 0 if it is not traced
+    uint64_t traceStart;
+};
+
+static const char* ASYNC_SPAN_NAMES[] = { "async_lookup", "async_getattr", "async_read", "async_readdir" };
+static const RequestScheduler::OpClass ASYNC_CLASSES[] = { RequestScheduler::STAT, RequestScheduler::STAT, RequestScheduler::READ, RequestScheduler::LIST };
+
+struct AsyncChunk {
+    AsyncRequest* request;
+    uint32_t index;
+    string path;
+};
+
+static void finishAsync(AsyncRequest* request) {
+    Tracer* tracer = request->fs->context->getTracer();
+    if (tracer && request->traceStart != 0) {
+        tracer->record(ASYNC_SPAN_NAMES[request->kind], request->path.c_str(), request->traceStart);
+    }
+    InFlightLimiter* limiter = request->fs->limiter.get();
+    RequestScheduler* scheduler = request->fs->context->getScheduler();
+    delete request;
+    limiter->release();
+    if (scheduler) {
+        scheduler->release();
+    }
+}
+
+static void replyAsyncError(AsyncRequest* request, int rc) {
+    // Lookups of names which do not exist are routine, not errors
+    Logger::LogLevel level = rc == ZNONODE && request->kind == AsyncRequest::LOOKUP ? Logger::DEBUG : Logger::ERROR;
+    LOG(request->fs->context, level, "Zookeeper Error: %d", rc);
+    fuse_reply_err(request->req, zooErrno(rc));
+    finishAsync(request);
+}
+
+static void replyBuffer(AsyncRequest* request, const string &content) {
+    size_t length = 0;
+    if (request->offset >= 0 && static_cast<size_t>(request->offset) < content.length()) {
+        length = std::min(request->size, content.length() - request->offset);
+    }
+    fuse_reply_buf(request->req, length > 0 ? content.data() + request->offset : NULL, length);
+}
+
+static void asyncChunkCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data);
+
+static void issueChunks(AsyncRequest* request, uint32_t last) {
+    size_t window = std::max<size_t>(request->fs->context->getFileOptions().chunkConcurrency, 1);
+    while (request->next <= last && request->pending < window && request->rc == ZOK) {
+        AsyncChunk* chunk = new AsyncChunk();
+        chunk->request = request;
+        chunk->index = request->next;
+        chunk->path = request->zooPath + "/" + request->manifest.getChunkName(request->next);
+
+        int rc = zoo_aget(request->fs->context->getZookeeperHandle(), chunk->path.c_str(), 0, asyncChunkCompletion, chunk);
+        if (rc != ZOK) {
+            delete chunk;
+            request->rc = rc;
+            break;
+        }
+        request->pending++;
+        request->next++;
+    }
+}
+
+static void asyncChunkCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    AsyncChunk* chunk = const_cast<AsyncChunk*>(reinterpret_cast<const AsyncChunk*>(data));
+    AsyncRequest* request = chunk->request;
+    request->pending--;
+
+    if (rc == ZOK && request->rc == ZOK) {
+        try {
+            string &decoded = request->chunks[chunk->index - request->first];
+            decoded = Codec::decode(value, valueLength > 0 ? valueLength : 0, request->manifest.getChunkLength(chunk->index));
+            if (decoded.length() != request->manifest.getChunkLength(chunk->index)) {
+                request->rc = ZDATAINCONSISTENCY;
+            }
+        } catch (const CodecException &e) {
+            request->rc = ZMARSHALLINGERROR;
+        }
+    } else if (request->rc == ZOK) {
+        request->rc = rc;
+    }
+    delete chunk;
+
+    uint32_t last = request->first + request->chunks.size() - 1;
+    issueChunks(request, last);
+    if (request->pending > 0) {
+        return;
+    }
+    if (request->rc != ZOK) {
+        replyAsyncError(request, request->rc);
+        return;
+    }
+
+    // Offsets are relative to the first fetched chunk from here on
+    string content;
+    for (size_t i = 0; i < request->chunks.size(); i++) {
+        content += request->chunks[i];
+    }
+    request->offset -= static_cast<off_t>(request->first) * request->manifest.getChunkSize();
+    replyBuffer(request, content);
+    finishAsync(request);
+}
+
+static void startChunkedRead(AsyncRequest* request) {
+    uint64_t length = request->manifest.getLength();
+    if (request->offset < 0 || static_cast<uint64_t>(request->offset) >= length || request->size == 0) {
+        fuse_reply_buf(request->req, NULL, 0);
+        finishAsync(request);
+        return;
+    }
+    uint64_t end = std::min<uint64_t>(length, request->offset + request->size);
+    request->first = request->offset / request->manifest.getChunkSize();
+    request->next = request->first;
+    uint32_t last = (end - 1) / request->manifest.getChunkSize();
+    request->chunks.resize(last - request->first + 1);
+
+    issueChunks(request, last);
+    if (request->pending == 0) {
+        replyAsyncError(request, request->rc);
+    }
+}
+
+static void asyncDataCompletion(int rc, const char *value, int valueLength, const struct Stat *stat, const void *data) {
+    AsyncRequest* request = const_cast<AsyncRequest*>(reinterpret_cast<const AsyncRequest*>(data));
+    LowLevelFs* fs = request->fs;
+    if (rc != ZOK) {
+        replyAsyncError(request, rc);
+        return;
+    }
+    size_t length = valueLength > 0 ? valueLength : 0;
+    bool chunked = ChunkManifest::decode(value, length, request->manifest);
+
+    if (request->kind == AsyncRequest::READ) {
+        if (chunked) {
+            startChunkedRead(request);
+            return;
+        }
+        try {
+            replyBuffer(request, Codec::decode(value, length, fs->context->getFileOptions().maxContentSize));
+        } catch (const CodecException &e) {
+            replyAsyncError(request, ZMARSHALLINGERROR);
+            return;
+        }
+        finishAsync(request);
+        return;
+    }
+
+    // The data and stat of one get are enough for the attributes, chunks are the only children of a chunked file
+    struct stat stbuf;
+    memset(&stbuf, 0, sizeof(stbuf));
+    bool isDir;
+    if (fs->context->getLeafMode() == LEAF_AS_DIR) {
+        isDir = !ZookeeperFuseContext::isDataNode(request->path);
+    } else {
+        isDir = stat->numChildren > 0 && !chunked;
+    }
+    if (isDir) {
+        stbuf.st_mode = S_IFDIR | 0755;
+        stbuf.st_nlink = 2;
+    } else {
+        stbuf.st_mode = S_IFREG | 0777;
+        stbuf.st_nlink = 1;
+        stbuf.st_size = chunked ? request->manifest.getLength() : Codec::decodedLength(value, length);
+    }
+
+    if (request->kind == AsyncRequest::LOOKUP) {
+        struct fuse_entry_param entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.ino = fs->inodes.lookup(request->path, request->zooPath);
+        entry.attr = stbuf;
+        entry.attr.st_ino = entry.ino;
+        entry.attr_timeout = ATTR_TIMEOUT;
+        entry.entry_timeout = ENTRY_TIMEOUT;
+        fs->inodes.setAttributes(entry.ino, entry.attr, *stat);
+        if (fuse_reply_entry(request->req, &entry) != 0) {
+            fs->inodes.forget(entry.ino, 1);
+        }
+    } else {
+        stbuf.st_ino = request->inode;
+        fs->inodes.setAttributes(request->inode, stbuf, *stat);
+        fuse_reply_attr(request->req, &stbuf, ATTR_TIMEOUT);
+    }
+    finishAsync(request);
+}
+
+static void asyncChildrenCompletion(int rc, const struct String_vector *strings, const void *data) {
+    AsyncRequest* request = const_cast<AsyncRequest*>(reinterpret_cast<const AsyncRequest*>(data));
+    if (rc != ZOK) {
+        replyAsyncError(request, rc);
+        return;
+    }
+
+    DirectoryListing &listing = *request->listing;
+    listing.reset(strings);
+    if (listing.hasDataNodeChild()) {
+        LOG(request->fs->context, Logger::ERROR, "zookeeper-fuse error: cannot be used on a node which has a child node called %s", ZookeeperFuseContext::DATA_NODE_NAME);
+        fuse_reply_err(request->req, EIO);
+        finishAsync(request);
+        return;
+    }
+    Prefetcher* prefetcher = request->fs->context->getPrefetcher();
+    if (prefetcher && request->offset == 0) {
+        vector<string> children;
+        listing.getChildren(children);
+        prefetcher->onReaddir(request->zooPath, children);
+    }
+
+    replyDirectory(request->req, listing, request->size, request->offset);
+    finishAsync(request);
+}
+
+/*
+ * Waits for admission and a limiter slot and starts the request, replying straight away if it could not be started
+ */
+static void dispatchAsync(AsyncRequest* request) {
+    LowLevelFs* fs = request->fs;
+    Tracer* tracer = fs->context->getTracer();
+    request->traceStart = tracer ? tracer->begin(false) : 0;
+    {
+        TraceSpan span(tracer, "throttle", request->path.c_str());
+        RequestScheduler* scheduler = fs->context->getScheduler();
+        if (scheduler) {
+            const struct fuse_ctx* caller = fuse_req_ctx(request->req);
+            scheduler->acquire(ASYNC_CLASSES[request->kind], scheduler->classify(caller->pid, caller->uid));
+        }
+        fs->limiter->acquire();
+    }
+
+    zhandle_t* handle = fs->context->getZookeeperHandle();
+    int rc = ZINVALIDSTATE;
+    if (handle != NULL) {
+        if (request->kind == AsyncRequest::READDIR) {
+            rc = zoo_awget_children(handle, request->zooPath.c_str(), nodeWatcher, fs, asyncChildrenCompletion, request);
+        } else {
+            rc = zoo_awget(handle, request->zooPath.c_str(), nodeWatcher, fs, asyncDataCompletion, request);
+        }
+    }
+    if (rc != ZOK) {
+        replyAsyncError(request, rc);
+    }
+}
+
+static void lookup_ll(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    LowLevelFs* fs = getFs(req);
+    string parentMountPath;
+    string parentZooPath;
+    if (!resolveInode(req, parent, parentMountPath, parentZooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: lookup_ll. Parent: %s Name: %s", parentMountPath.c_str(), name);
+    TraceSpan span(fs->context->getTracer(), "lookup_ll", name, true);
+
+    string path = childPath(parentMountPath, name);
+    string zooPath = fs->context->resolvePath(path);
+    if (canDispatchAsync(fs, zooPath)) {
+        AsyncRequest* request = new AsyncRequest(req, fs, AsyncRequest::LOOKUP);
+        request->path = path;
+        request->zooPath = zooPath;
+        dispatchAsync(request);
+        return;
+    }
+
+    SCHEDULE_REQUEST(fs, req, STAT);
+    replyEntry(req, path, zooPath);
+}
+
+static void forget_ll(fuse_req_t req, fuse_ino_t ino, unsigned long nlookup) {
+    getFs(req)->inodes.forget(ino, nlookup);
+    fuse_reply_none(req);
+}
+
+static void getattr_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: getattr_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "getattr_ll", path.c_str(), true);
+
+    struct stat cached;
+    if (canDispatchAsync(fs, zooPath) && !fs->inodes.getAttributes(ino, cached)) {
+        AsyncRequest* request = new AsyncRequest(req, fs, AsyncRequest::GETATTR);
+        request->inode = ino;
+        request->path = path;
+        request->zooPath = zooPath;
+        dispatchAsync(request);
+        return;
+    }
+
+    SCHEDULE_REQUEST(fs, req, STAT);
+    struct stat stbuf;
+    int rc = getAttributes(fs, ino, path, zooPath, &stbuf);
+    if (rc != 0) {
+        fuse_reply_err(req, -rc);
+    } else {
+        fuse_reply_attr(req, &stbuf, ATTR_TIMEOUT);
+    }
+}
+
+static void setattr_ll(fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: setattr_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "setattr_ll", path.c_str(), true);
+
+    // Modes, owners and times are not stored in the zoo, only truncation has an effect
+    SCHEDULE_REQUEST(fs, req, WRITE);
+    if (to_set & FUSE_SET_ATTR_SIZE) {
+        auto_ptr<ZooFile> file(openFile(fs, zooPath));
+        ZooResult<string> content = file->getContent();
+        if (!content.ok()) {
+            fuse_reply_err(req, zooError(fs, content));
+            return;
+        }
+        content.get().resize(attr->st_size);
+        ZooStatus status = file->setContent(content.get());
+        if (!status.ok()) {
+            fuse_reply_err(req, zooError(fs, status));
+            return;
+        }
+        fs->inodes.invalidate(zooPath);
+    }
+
+    struct stat stbuf;
+    int rc = getAttributes(fs, ino, path, zooPath, &stbuf);
+    if (rc != 0) {
+        fuse_reply_err(req, -rc);
+    } else {
+        fuse_reply_attr(req, &stbuf, ATTR_TIMEOUT);
+    }
+}
+
+static void readdir_ll(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: readdir_ll. Path: %s Offset: %ld", path.c_str(), (long) off);
+    TraceSpan span(fs->context->getTracer(), "readdir_ll", path.c_str(), true);
+
+    DirectoryListing* listing = reinterpret_cast<DirectoryListing*>(fi->fh);
+    if (!listing->needsListing(off)) {
+        replyDirectory(req, *listing, size, off);
+        return;
+    }
+    if (canDispatchAsync(fs, zooPath)) {
+        AsyncRequest* request = new AsyncRequest(req, fs, AsyncRequest::READDIR);
+        request->path = path;
+        request->zooPath = zooPath;
+        request->size = size;
+        request->offset = off;
+        request->listing = listing;
+        dispatchAsync(request);
+        return;
+    }
+
+    SCHEDULE_REQUEST(fs, req, LIST);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooResult<vector<string> > result = file->getChildren();
+    if (!result.ok()) {
+        fuse_reply_err(req, zooError(fs, result));
+        return;
+    }
+    if (fs->context->getPrefetcher() && off == 0) {
+        fs->context->getPrefetcher()->onReaddir(zooPath, result.get());
+    }
+    listing->reset(result.get());
+    if (listing->hasDataNodeChild()) {
+        LOG(fs->context, Logger::ERROR, "zookeeper-fuse error: cannot be used on a node which has a child node called %s", ZookeeperFuseContext::DATA_NODE_NAME);
+        fuse_reply_err(req, EIO);
+        return;
+    }
+    replyDirectory(req, *listing, size, off);
+}
+
+// The listing is taken by the first readdir, see DirectoryListing
+static void opendir_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    DirectoryListing* listing = new DirectoryListing(ZookeeperFuseContext::DATA_NODE_NAME);
+    fi->fh = reinterpret_cast<uint64_t>(listing);
+    if (fuse_reply_open(req, fi) != 0) {
+        delete listing;
+    }
+}
+
+static void releasedir_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    delete reinterpret_cast<DirectoryListing*>(fi->fh);
+    fuse_reply_err(req, 0);
+}
+
+static OpenFile* setOpenFile(LowLevelFs* fs, struct fuse_file_info *fi) {
+    OpenFile* file = new OpenFile();
+    file->seen = fs->context->getPollRegistry().getGeneration();
+    fi->fh = reinterpret_cast<uint64_t>(file);
+    return file;
+}
+
+static OpenFile* getOpenFile(struct fuse_file_info *fi) {
+    return fi != NULL ? reinterpret_cast<OpenFile*>(fi->fh) : NULL;
+}
+
+static void open_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    OpenFile* file = setOpenFile(getFs(req), fi);
+    if (fuse_reply_open(req, fi) != 0) {
+        // The kernel never saw the file, so it will never release it either
+        delete file;
+    }
+}
+
+static void release_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi) {
+    OpenFile* file = getOpenFile(fi);
+    if (file != NULL) {
+        getFs(req)->context->getPollRegistry().detach(file->polled);
+    }
+    delete file;
+    fuse_reply_err(req, 0);
+}
+
+static void read_ll(fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: read_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "read_ll", path.c_str(), true);
+
+    OpenFile* opened = getOpenFile(fi);
+    if (opened != NULL) {
+        fs->context->getPollRegistry().markRead(opened->seen);
+    }
+    if (fs->context->getPrefetcher() && off == 0) {
+        fs->context->getPrefetcher()->onRead(zooPath);
+    }
+    if (canDispatchAsync(fs, zooPath)) {
+        AsyncRequest* request = new AsyncRequest(req, fs, AsyncRequest::READ);
+        request->path = path;
+        request->zooPath = zooPath;
+        request->size = size;
+        request->offset = off;
+        dispatchAsync(request);
+        return;
+    }
+
+    SCHEDULE_REQUEST(fs, req, READ);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    vector<char> buffer(size);
+    ZooResult<size_t> length = size > 0 ? file->read(&buffer[0], size, off) : ZooResult<size_t>(0);
+    if (!length.ok()) {
+        fuse_reply_err(req, zooError(fs, length));
+        return;
+    }
+    fuse_reply_buf(req, length.get() > 0 ? &buffer[0] : NULL, length.get());
+}
+
+static void write_ll(fuse_req_t req, fuse_ino_t ino, const char *buf, size_t size, off_t off, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: write_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "write_ll", path.c_str(), true);
+
+    if (off + size > fs->context->getMaxFileSize()) {
+        LOG(fs->context, Logger::ERROR, "Attempting to write past maximum file size of %d", fs->context->getMaxFileSize());
+        fuse_reply_err(req, EINVAL);
+        return;
+    }
+
+    SCHEDULE_REQUEST(fs, req, WRITE);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooStatus status = file->write(buf, size, off);
+    if (!status.ok()) {
+        fuse_reply_err(req, zooError(fs, status));
+        return;
+    }
+    fs->inodes.invalidate(zooPath);
+    fuse_reply_write(req, size);
+}
+
+static void fsync_ll(fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: fsync_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "fsync_ll", path.c_str(), true);
+    SCHEDULE_REQUEST(fs, req, WRITE);
+
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooStatus status = file->sync();
+    fuse_reply_err(req, status.ok() ? 0 : zooError(fs, status));
+}
+
+static void replyXattr(fuse_req_t req, const string &value, size_t size) {
+    if (size == 0) {
+        fuse_reply_xattr(req, value.length());
+    } else if (size < value.length()) {
+        fuse_reply_err(req, ERANGE);
+    } else {
+        fuse_reply_buf(req, value.data(), value.length());
+    }
+}
+
+static void getxattr_ll(fuse_req_t req, fuse_ino_t ino, const char *name, size_t size) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: getxattr_ll. Path: %s Name: %s", path.c_str(), name);
+    TraceSpan span(fs->context->getTracer(), "getxattr_ll", path.c_str(), true);
+
+    // Served from the Stat cached alongside the attributes whenever getattr already ran
+    SCHEDULE_REQUEST(fs, req, STAT);
+    struct stat stbuf;
+    Stat zooStat;
+    int rc = getAttributes(fs, ino, path, zooPath, &stbuf, &zooStat);
+    if (rc != 0) {
+        fuse_reply_err(req, -rc);
+        return;
+    }
+    string value;
+    if (!StatAttributes::get(zooStat, name, value)) {
+        fuse_reply_err(req, ENODATA);
+        return;
+    }
+    replyXattr(req, value, size);
+}
+
+static void listxattr_ll(fuse_req_t req, fuse_ino_t ino, size_t size) {
+    replyXattr(req, StatAttributes::list(), size);
+}
+
+static void create_ll(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, struct fuse_file_info *fi) {
+    LowLevelFs* fs = getFs(req);
+    string parentMountPath;
+    string parentZooPath;
+    if (!resolveInode(req, parent, parentMountPath, parentZooPath)) {
+        return;
+    }
+    string path = childPath(parentMountPath, name);
+    LOG(fs->context, Logger::DEBUG, "In: create_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "create_ll", path.c_str(), true);
+
+    if (fs->context->getLeafMode() == LEAF_AS_DIR) {
+        LOG(fs->context, Logger::ERROR, "File creation is only allowed via mkdir in LEAF_AS_DIR mode. Path: %s", path.c_str());
+        fuse_reply_err(req, ENOENT);
+        return;
+    }
+
+    string zooPath = fs->context->resolvePath(path);
+    SCHEDULE_REQUEST(fs, req, WRITE);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooResult<bool> exists = file->exits();
+    if (!exists.ok()) {
+        fuse_reply_err(req, zooError(fs, exists));
+        return;
+    }
+    if (!exists.get()) {
+        ZooStatus status = file->create();
+        if (!status.ok()) {
+            fuse_reply_err(req, zooError(fs, status));
+            return;
+        }
+    }
+
+    struct fuse_entry_param entry;
+    memset(&entry, 0, sizeof(entry));
+    int rc = getAttributes(fs, 0, path, zooPath, &entry.attr);
+    if (rc != 0) {
+        fuse_reply_err(req, -rc);
+        return;
+    }
+    entry.ino = fs->inodes.lookup(path, zooPath);
+    entry.attr.st_ino = entry.ino;
+    entry.attr_timeout = ATTR_TIMEOUT;
+    entry.entry_timeout = ENTRY_TIMEOUT;
+    OpenFile* opened = setOpenFile(fs, fi);
+    if (fuse_reply_create(req, &entry, fi) != 0) {
+        fs->inodes.forget(entry.ino, 1);
+        delete opened;
+    }
+}
+
+static void mkdir_ll(fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode) {
+    LowLevelFs* fs = getFs(req);
+    string parentMountPath;
+    string parentZooPath;
+    if (!resolveInode(req, parent, parentMountPath, parentZooPath)) {
+        return;
+    }
+    string path = childPath(parentMountPath, name);
+    LOG(fs->context, Logger::DEBUG, "In: mkdir_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "mkdir_ll", path.c_str(), true);
+
+    string zooPath = fs->context->resolvePath(path);
+    SCHEDULE_REQUEST(fs, req, WRITE);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooResult<bool> exists = file->exits();
+    if (!exists.ok()) {
+        fuse_reply_err(req, zooError(fs, exists));
+        return;
+    }
+    if (!exists.get()) {
+        ZooStatus status = file->create();
+        if (!status.ok()) {
+            fuse_reply_err(req, zooError(fs, status));
+            return;
+        }
+    }
+    replyEntry(req, path, zooPath);
+}
+
+static void unlink_ll(fuse_req_t req, fuse_ino_t parent, const char *name) {
+    LowLevelFs* fs = getFs(req);
+    string parentMountPath;
+    string parentZooPath;
+    if (!resolveInode(req, parent, parentMountPath, parentZooPath)) {
+        return;
+    }
+    string path = childPath(parentMountPath, name);
+    LOG(fs->context, Logger::DEBUG, "In: unlink_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "unlink_ll", path.c_str(), true);
+
+    string zooPath = fs->context->resolvePath(path);
+    SCHEDULE_REQUEST(fs, req, WRITE);
+    auto_ptr<ZooFile> file(openFile(fs, zooPath));
+    ZooStatus status = file->remove();
+    if (!status.ok()) {
+        fuse_reply_err(req, zooError(fs, status));
+        return;
+    }
+    fs->inodes.unlink(path);
+    fs->inodes.invalidate(parentZooPath);
+    fuse_reply_err(req, 0);
+}
+
+// Waits for the node to change, files read as POLLIN once it did since their last read
+static void poll_ll(fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi, struct fuse_pollhandle *ph) {
+    LowLevelFs* fs = getFs(req);
+    string path;
+    string zooPath;
+    if (!resolveInode(req, ino, path, zooPath)) {
+        if (ph != NULL) {
+            fuse_pollhandle_destroy(ph);
+        }
+        return;
+    }
+    LOG(fs->context, Logger::DEBUG, "In: poll_ll. Path: %s", path.c_str());
+    TraceSpan span(fs->context->getTracer(), "poll_ll", path.c_str(), true);
+
+    OpenFile* opened = getOpenFile(fi);
+    zhandle_t* zh = fs->context->getZookeeperHandle();
+    if (opened == NULL || zh == NULL) {
+        if (ph != NULL) {
+            fuse_pollhandle_destroy(ph);
+        }
+        fuse_reply_err(req, EIO);
+        return;
+    }
+    fuse_reply_poll(req, fs->context->getPollRegistry().poll(zh, zooPath, opened->seen, opened->polled, ph));
+}
+
+int runLowLevel(int argc, char** argv, ZookeeperFuseContext* context, size_t maxInFlight) {
+    struct fuse_lowlevel_ops operations;
+    memset(&operations, 0, sizeof(operations));
+    operations.lookup = lookup_ll;
+    operations.forget = forget_ll;
+    operations.getattr = getattr_ll;
+    operations.setattr = setattr_ll;
+    operations.readdir = readdir_ll;
+    operations.opendir = opendir_ll;
+    operations.releasedir = releasedir_ll;
+    operations.open = open_ll;
+    operations.release = release_ll;
+    operations.poll = poll_ll;
+    operations.read = read_ll;
+    operations.write = write_ll;
+    operations.fsync = fsync_ll;
+    operations.getxattr = getxattr_ll;
+    operations.listxattr = listxattr_ll;
+    operations.create = create_ll;
+    operations.mkdir = mkdir_ll;
+    operations.unlink = unlink_ll;
+    operations.rmdir = unlink_ll;
+
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    char *mountpoint = NULL;
+    int multithreaded = 0;
+    int foreground = 0;
+    int err = -1;
+
+    if (fuse_parse_cmdline(&args, &mountpoint, &multithreaded, &foreground) == -1) {
+        return 1;
+    }
+
+    LowLevelFs fs(context, maxInFlight);
+    struct fuse_chan *channel = fuse_mount(mountpoint, &args);
+    if (channel != NULL) {
+        struct fuse_session *session = fuse_lowlevel_new(&args, &operations, sizeof(operations), &fs);
+        if (session != NULL) {
+            if (fuse_set_signal_handlers(session) != -1) {
+                fuse_session_add_chan(session, channel);
+                fuse_daemonize(foreground);
+                fs.notifier.start(channel);
+                err = multithreaded ? fuse_session_loop_mt(session) : fuse_session_loop(session);
+
+                // Closing fails the pending completions with ZCLOSING, which still reply through the session.
+                // Watches and completions reference the inode table and the channel, so they have to be over
+                // before either goes
+                context->closeZookeeperHandle();
+                fs.notifier.stop();
+                fuse_remove_signal_handlers(session);
+                fuse_session_remove_chan(channel);
+            }
+            fuse_session_destroy(session);
+        }
+        fuse_unmount(mountpoint, channel);
+    }
+    fuse_opt_free_args(&args);
+    free(mountpoint);
+
+    // A no-op once closed above, covers mounts that failed to start
+    context->closeZookeeperHandle();
+
+    if (fs.limiter.get()) {
+        LOG(context, Logger::INFO, "Asynchronous dispatch: %lu requests, %lu throttled at %lu in flight",
+            (unsigned long) fs.limiter->getDispatched(), (unsigned long) fs.limiter->getThrottled(),
+            (unsigned long) fs.limiter->getLimit());
+    }
+
+    return err ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZookeeperFuseLowLevel.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 2:05 PM
+ */
+
+#ifndef ZOOKEEPERFUSELOWLEVEL_H
+#define ZOOKEEPERFUSELOWLEVEL_H
+
+#include "ZookeeperFuseContext.h"
+
+/*
+ * Serves the mount through the fuse low level api.
+ *
+ * Requests are resolved by inode instead of by path, and watches left on every node served to the kernel
+ * invalidate exactly the affected inodes and directory entries when the node changes in the zoo.
+ * Takes the fuse arguments (everything before the "--" divider) and blocks until the mount is released.
+ *
+ * With maxInFlight above 0, lookups, getattr, readdir and reads are answered from zookeeper completions,
+ * with at most maxInFlight of them outstanding. Otherwise every request blocks a fuse worker until done.
+ */
+int runLowLevel(int argc, char** argv, ZookeeperFuseContext* context, size_t maxInFlight = 0);
+
+#endif /* ZOOKEEPERFUSELOWLEVEL_H */
@@ -0,0 +1,381 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZookeeperFuseReplay.cpp
+ * Author: kyle
+ *
+ * Created on October 22, 2026, 2:35 PM
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/xattr.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "WorkloadTrace.h"
+
+using namespace std;
+
+/*
+ * A descriptor opened by a replayed open or create. Fuse hands open, read and release of one file to
+ * whichever of its threads is free, so descriptors are shared by all workers and closed by the last one
+ * to let go of it.
+ */
+class ReplayHandle {
+public:
+    ReplayHandle(int fd) :
+    fd_(fd) {
+
+    }
+
+    ~ReplayHandle() {
+        close(fd_);
+    }
+
+    int get() const {
+        return fd_;
+    }
+
+private:
+    ReplayHandle(const ReplayHandle& orig);
+    ReplayHandle& operator=(const ReplayHandle &rhs);
+
+    int fd_;
+};
+
+struct ReplayState {
+    string root;
+    double speed;
+    uint64_t begin;
+    boost::mutex mutex;
+    map<string, vector<boost::shared_ptr<ReplayHandle> > > handles;
+};
+
+struct ReplayResult {
+    vector<uint64_t> latencies[OP_COUNT];
+    uint64_t errors[OP_COUNT];
+};
+
+static void openHandle(ReplayState *state, const string &path, int fd) {
+    if (fd >= 0) {
+        boost::lock_guard<boost::mutex> lock(state->mutex);
+        state->handles[path].push_back(boost::shared_ptr<ReplayHandle>(new ReplayHandle(fd)));
+    }
+}
+
+static void closeHandle(ReplayState *state, const string &path) {
+    boost::lock_guard<boost::mutex> lock(state->mutex);
+    map<string, vector<boost::shared_ptr<ReplayHandle> > >::iterator it = state->handles.find(path);
+    if (it != state->handles.end()) {
+        it->second.pop_back();
+        if (it->second.empty()) {
+            state->handles.erase(it);
+        }
+    }
+}
+
+// Returns a descriptor opened by an earlier replayed open, or one opened just for this operation
+static boost::shared_ptr<ReplayHandle> getHandle(ReplayState *state, const string &path, int flags) {
+    {
+        boost::lock_guard<boost::mutex> lock(state->mutex);
+        map<string, vector<boost::shared_ptr<ReplayHandle> > >::iterator it = state->handles.find(path);
+        if (it != state->handles.end()) {
+            return it->second.back();
+        }
+    }
+    int fd = open(path.c_str(), flags);
+    return fd >= 0 ? boost::shared_ptr<ReplayHandle>(new ReplayHandle(fd)) : boost::shared_ptr<ReplayHandle>();
+}
+
+// Issues the system call which makes the kernel send the recorded operation, returns false if it failed
+static bool replay(ReplayState *state, const WorkloadRecord &record, vector<char> &buffer) {
+    string path = state->root + record.path;
+    if (buffer.size() < record.size) {
+        buffer.resize(record.size, 'x');
+    }
+    char *data = buffer.empty() ? NULL : &buffer[0];
+    boost::shared_ptr<ReplayHandle> handle;
+    struct stat stbuf;
+
+    switch (record.op) {
+        case OP_GETATTR:
+            return lstat(path.c_str(), &stbuf) == 0;
+        case OP_READDIR: {
+            // Pages past the first are read by the walk below
+            if (record.offset != 0) {
+                return true;
+            }
+            DIR *dir = opendir(path.c_str());
+            if (dir == NULL) {
+                return false;
+            }
+            while (readdir(dir) != NULL) {
+            }
+            closedir(dir);
+            return true;
+        }
+        case OP_OPEN: {
+            int fd = open(path.c_str(), static_cast<int>(record.size) & ~(O_CREAT | O_EXCL));
+            openHandle(state, record.path, fd);
+            return fd >= 0;
+        }
+        case OP_READ:
+            handle = getHandle(state, path, O_RDONLY);
+            return handle && pread(handle->get(), data, record.size, record.offset) >= 0;
+        case OP_WRITE:
+            handle = getHandle(state, path, O_WRONLY);
+            return handle && pwrite(handle->get(), data, record.size, record.offset) >= 0;
+        case OP_CHMOD:
+            return chmod(path.c_str(), record.size & 07777) == 0;
+        case OP_CHOWN:
+            return chown(path.c_str(), record.offset, record.size) == 0;
+        case OP_UTIME:
+            return utime(path.c_str(), NULL) == 0;
+        case OP_CREATE: {
+            int fd = open(path.c_str(), O_CREAT | O_RDWR, record.size & 07777);
+            openHandle(state, record.path, fd);
+            return fd >= 0;
+        }
+        case OP_TRUNCATE:
+            return truncate(path.c_str(), record.offset) == 0;
+        case OP_UNLINK:
+            // rmdir is served by the same callback
+            return unlink(path.c_str()) == 0 || ((errno == EISDIR || errno == EPERM) && rmdir(path.c_str()) == 0);
+        case OP_MKDIR:
+            return mkdir(path.c_str(), record.size & 07777) == 0;
+        case OP_FSYNC:
+            handle = getHandle(state, path, O_RDONLY);
+            return handle && (record.size ? fdatasync(handle->get()) : fsync(handle->get())) == 0;
+        case OP_GETXATTR:
+            return lgetxattr(path.c_str(), record.name.c_str(), data, record.size) >= 0;
+        case OP_LISTXATTR:
+            return llistxattr(path.c_str(), data, record.size) >= 0;
+        case OP_FLUSH:
+            // Sent by the kernel on every close, replayed as part of release
+            return true;
+        case OP_RELEASE:
+            closeHandle(state, record.path);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void runWorker(ReplayState *state, const vector<const WorkloadRecord*> *records, ReplayResult *result) {
+    vector<char> buffer;
+    for (size_t i = 0; i < OP_COUNT; i++) {
+        result->errors[i] = 0;
+    }
+    for (size_t i = 0; i < records->size(); i++) {
+        const WorkloadRecord &record = *(*records)[i];
+        if (state->speed > 0) {
+            uint64_t due = state->begin + static_cast<uint64_t>(record.start / state->speed);
+            uint64_t now = WorkloadRecorder::now();
+            if (due > now) {
+                boost::this_thread::sleep(boost::posix_time::microseconds(due - now));
+            }
+        }
+        uint64_t start = WorkloadRecorder::now();
+        bool succeeded = replay(state, record, buffer);
+        if (record.op != OP_FLUSH) {
+            result->latencies[record.op].push_back(WorkloadRecorder::now() - start);
+        }
+        if (!succeeded) {
+            result->errors[record.op]++;
+        }
+    }
+}
+
+static uint64_t percentile(const vector<uint64_t> &sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+}
+
+static void printLatencies(const char *name, vector<uint64_t> &latencies, uint64_t errors) {
+    sort(latencies.begin(), latencies.end());
+    printf("%-10s %10lu %8lu %10lu %10lu %10lu %10lu %10lu\n", name, (unsigned long) latencies.size(),
+           (unsigned long) errors, (unsigned long) percentile(latencies, 0.5), (unsigned long) percentile(latencies, 0.9),
+           (unsigned long) percentile(latencies, 0.99), (unsigned long) percentile(latencies, 0.999),
+           (unsigned long) (latencies.empty() ? 0 : latencies.back()));
+}
+
+static bool byStart(const WorkloadRecord *lhs, const WorkloadRecord *rhs) {
+    return lhs->start < rhs->start;
+}
+
+/*
+ * ZookeeperFuseReplay Main Function
+ *
+ * Replays a capture written by zookeeperfuse --record against the directory given by --root, which can be a
+ * zookeeperfuse mount or any local directory (e.g. on a tmpfs) as a baseline. Each operation is issued as the
+ * system call that makes the kernel send it, so the kernel's own caching applies as it did during capture.
+ *
+ * Operations of a recorded thread are replayed in order by one worker, recorded threads are spread over
+ * --threads workers. With --speed 1 operations start at their recorded offsets, higher speeds compress the
+ * schedule and 0 replays as fast as possible. Prints throughput and latency percentiles per operation, next
+ * to the latencies recorded at capture time.
+ */
+int main(int argc, char** argv) {
+    string captureFile;
+    ReplayState state;
+    state.speed = 1.0;
+    size_t threads = 0;
+
+    struct option longopts[] = {
+        { "help", no_argument, NULL, 'h'},
+        { "capture", required_argument, NULL, 'i'},
+        { "root", required_argument, NULL, 'r'},
+        { "speed", required_argument, NULL, 's'},
+        { "threads", required_argument, NULL, 'n'},
+        { 0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "hi:r:s:n:", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
+                        "--help              -h          print this usage\n"
+                        "--capture           -i          capture written by zookeeperfuse --record\n"
+                        "--root              -r          directory to replay against, a mount or a local directory\n"
+                        "--speed             -s          multiple of the recorded speed, 0 replays as fast as possible (default=1)\n"
+                        "--threads           -n          number of replaying threads (default=0, one per recorded thread)\n";
+                exit(0);
+                break;
+            case 'i':
+                captureFile = optarg;
+                break;
+            case 'r':
+                state.root = optarg;
+                break;
+            case 's':
+                state.speed = atof(optarg);
+                break;
+            case 'n':
+                threads = atoi(optarg);
+                break;
+        }
+    }
+    if (captureFile.empty() || state.root.empty()) {
+        cerr << "Both --capture and --root are required" << endl;
+        return 1;
+    }
+    if (state.root.length() > 1 && state.root[state.root.length() - 1] == '/') {
+        state.root.erase(state.root.length() - 1);
+    }
+
+    vector<WorkloadRecord> records;
+    try {
+        records = WorkloadReader::read(captureFile);
+    } catch (const WorkloadTraceException &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    if (records.empty()) {
+        cerr << "The capture holds no operations" << endl;
+        return 1;
+    }
+
+    uint32_t recordedThreads = 0;
+    uint64_t recordedSpan = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        recordedThreads = max(recordedThreads, records[i].thread + 1);
+        recordedSpan = max(recordedSpan, records[i].start + records[i].duration);
+    }
+    if (threads == 0) {
+        threads = recordedThreads;
+    }
+
+    vector<vector<const WorkloadRecord*> > schedules(threads);
+    vector<uint64_t> recorded[OP_COUNT];
+    for (size_t i = 0; i < records.size(); i++) {
+        schedules[records[i].thread % threads].push_back(&records[i]);
+        if (records[i].op != OP_FLUSH) {
+            recorded[records[i].op].push_back(records[i].duration);
+        }
+    }
+    for (size_t i = 0; i < threads; i++) {
+        stable_sort(schedules[i].begin(), schedules[i].end(), byStart);
+    }
+
+    vector<ReplayResult> results(threads);
+    boost::thread_group workers;
+    state.begin = WorkloadRecorder::now();
+    for (size_t i = 0; i < threads; i++) {
+        workers.create_thread(boost::bind(runWorker, &state, &schedules[i], &results[i]));
+    }
+    workers.join_all();
+    uint64_t elapsed = WorkloadRecorder::now() - state.begin;
+    state.handles.clear();
+
+    printf("Replayed %lu operations of %u recorded threads on %lu threads in %.3f s (recorded %.3f s), %.1f ops/s\n\n",
+           (unsigned long) records.size(), recordedThreads, (unsigned long) threads, elapsed / 1e6, recordedSpan / 1e6,
+           records.size() / (elapsed > 0 ? elapsed / 1e6 : 1.0));
+    printf("%-10s %10s %8s %10s %10s %10s %10s %10s\n", "replayed", "count", "errors", "p50 us", "p90 us", "p99 us",
+           "p99.9 us", "max us");
+    vector<uint64_t> all;
+    uint64_t allErrors = 0;
+    for (int op = 0; op < OP_COUNT; op++) {
+        for (size_t i = 0; i < threads; i++) {
+            all.insert(all.end(), results[i].latencies[op].begin(), results[i].latencies[op].end());
+            allErrors += results[i].errors[op];
+        }
+    }
+    for (int op = 0; op < OP_COUNT; op++) {
+        vector<uint64_t> latencies;
+        uint64_t errors = 0;
+        for (size_t i = 0; i < threads; i++) {
+            latencies.insert(latencies.end(), results[i].latencies[op].begin(), results[i].latencies[op].end());
+            errors += results[i].errors[op];
+        }
+        if (!latencies.empty()) {
+            printLatencies(WorkloadRecord::opToString(static_cast<WorkloadOp>(op)), latencies, errors);
+        }
+    }
+    printLatencies("all", all, allErrors);
+
+    printf("\n%-10s %10s %8s %10s %10s %10s %10s %10s\n", "recorded", "count", "", "p50 us", "p90 us", "p99 us",
+           "p99.9 us", "max us");
+    vector<uint64_t> allRecorded;
+    for (int op = 0; op < OP_COUNT; op++) {
+        allRecorded.insert(allRecorded.end(), recorded[op].begin(), recorded[op].end());
+        if (!recorded[op].empty()) {
+            printLatencies(WorkloadRecord::opToString(static_cast<WorkloadOp>(op)), recorded[op], 0);
+        }
+    }
+    printLatencies("all", allRecorded, 0);
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ArenaBench.cpp
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 12:10 PM
+ */
+
+/*
+ * Heap allocations per callback of the request arena against path strings.
+ *
+ * Each of --threads threads runs the part of getattr that happens before the zoo is contacted: the callback
+ * log line, the archive entry check, resolving the path and opening the ZooFile. The arena resolves into its
+ * first block, with --baseline the path is resolved into a string and the checks build their temporaries
+ * as they did before. Every operator new is counted, the context is never connected.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../RequestArena.h"
+#include "../ZooFile.h"
+#include "../ZookeeperFuseContext.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+    __sync_fetch_and_add(&allocations, 1);
+    void *retval = malloc(size > 0 ? size : 1);
+    if (retval == NULL) {
+        throw std::bad_alloc();
+    }
+    return retval;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *pointer) {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) {
+    free(pointer);
+}
+
+static const string exportDir = "/.archive/export";
+static const string importDir = "/.archive/import";
+
+static size_t callbackInit(const char *callback, const char *path) {
+    return strlen(callback) + strlen(path);
+}
+
+static size_t callbackInit(const string &callback, const string &path) {
+    return callback.length() + path.length();
+}
+
+static bool isArchiveEntry(const char *path) {
+    return (strncmp(path, exportDir.c_str(), exportDir.length()) == 0 && path[exportDir.length()] == '/')
+            || (strncmp(path, importDir.c_str(), importDir.length()) == 0 && path[importDir.length()] == '/');
+}
+
+static bool isArchiveEntry(const string &path) {
+    return path.compare(0, exportDir.length() + 1, exportDir + "/") == 0
+            || path.compare(0, importDir.length() + 1, importDir + "/") == 0;
+}
+
+class Worker {
+public:
+    Worker(ZookeeperFuseContext *context, const vector<string> &paths, size_t ops, bool baseline) :
+    context_(context), paths_(paths), ops_(ops), baseline_(baseline), checksum_(0) {
+
+    }
+
+    void operator()() {
+        for (size_t i = 0; i < ops_; i++) {
+            const char *path = paths_[i % paths_.size()].c_str();
+            if (baseline_) {
+                // The callbacks took strings, so every argument was copied into one
+                checksum_ += callbackInit(string("getattr_callback"), string(path));
+                if (!isArchiveEntry(string(path))) {
+                    string fullPath = context_->resolvePath(string(path));
+                    ZooFile file(NULL, fullPath, context_->getFileOptions());
+                    checksum_ += fullPath.length() + file.isCoveredByWatch();
+                }
+            } else {
+                RequestArena::Scope arenaScope;
+                checksum_ += callbackInit("getattr_callback", path);
+                if (!isArchiveEntry(path)) {
+                    const char *fullPath = context_->resolvePath(path, RequestArena::get());
+                    ZooFile file(NULL, fullPath, context_->getFileOptions());
+                    checksum_ += strlen(fullPath) + file.isCoveredByWatch();
+                }
+            }
+        }
+    }
+
+    size_t getChecksum() const {
+        return checksum_;
+    }
+
+private:
+    ZookeeperFuseContext *context_;
+    const vector<string> &paths_;
+    size_t ops_;
+    bool baseline_;
+    size_t checksum_;
+};
+
+int main(int argc, char** argv) {
+    size_t threads = 4;
+    size_t ops = 1000000;
+    bool baseline = false;
+
+    struct option longopts[] = {
+        { "help", no_argument, NULL, 'h'},
+        { "threads", required_argument, NULL, 't'},
+        { "ops", required_argument, NULL, 'o'},
+        { "baseline", no_argument, NULL, 'B'},
+        { 0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "ht:o:B", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
+                        "--help              -h          print this usage\n"
+                        "--threads           -t          number of threads running callbacks (default=4)\n"
+                        "--ops               -o          callbacks per thread (default=1000000)\n"
+                        "--baseline          -B          resolve paths into strings instead of the request arena\n";
+                exit(0);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'B':
+                baseline = true;
+                break;
+        }
+    }
+    if (threads == 0 || ops == 0) {
+        cerr << "--threads and --ops must be positive" << endl;
+        return 1;
+    }
+
+    ZookeeperFuseContext context(Logger::ERROR, "localhost:2181", "", "", "/services/config", LEAF_AS_FILE, 1024);
+    vector<string> paths;
+    for (size_t i = 0; i < 1024; i++) {
+        ostringstream path;
+        path << "/service" << i / 32 << "/group" << i % 32 << "/endpoints.json";
+        paths.push_back(path.str());
+    }
+
+    vector<Worker> workers(threads, Worker(&context, paths, ops, baseline));
+    boost::thread_group group;
+    unsigned long before = allocations;
+    ptime start = microsec_clock::universal_time();
+    for (size_t i = 0; i < threads; i++) {
+        group.create_thread(boost::ref(workers[i]));
+    }
+    group.join_all();
+    double seconds = static_cast<double>((microsec_clock::universal_time() - start).total_microseconds()) / 1000000;
+    unsigned long after = allocations;
+
+    size_t checksum = 0;
+    for (size_t i = 0; i < threads; i++) {
+        checksum += workers[i].getChecksum();
+    }
+    cout << (baseline ? "string paths" : "request arena") << ": " << threads << " threads, "
+         << static_cast<double>(after - before) / (threads * ops) << " allocations/op, "
+         << threads * ops / seconds << " ops/s (checksum " << checksum << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   CodecBench.cpp
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 11:20 AM
+ */
+
+/*
+ * Bytes on the wire and CPU cost of the payload codecs.
+ *
+ * Encodes a payload, either --input or a generated JSON config of --size bytes, with every codec compiled
+ * in and reports the stored size, which is what every read and write of the node transfers, and the CPU
+ * time of an encode and of a decode, the latter being paid by every read.
+ */
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <getopt.h>
+#include <stdlib.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "../codec/Codec.h"
+
+using namespace std;
+
+static string generateConfig(size_t size) {
+    ostringstream config;
+    config << "{\n  \"services\": [\n";
+    for (size_t i = 0; static_cast<size_t>(config.tellp()) < size; i++) {
+        config << "    { \"name\": \"service-" << i << "\", \"replicas\": " << i % 7 + 1
+               << ", \"enabled\": " << (i % 3 != 0 ? "true" : "false") << ", \"endpoints\": [ \"10.0."
+               << i % 256 << "." << (i * 37) % 256 << ":" << 8000 + i % 1000 << "\" ], \"timeoutMillis\": "
+               << (i % 10 + 1) * 250 << " },\n";
+    }
+    string retval = config.str();
+    retval.resize(size);
+    return retval;
+}
+
+static double cpuMicros(clock_t start, size_t iterations) {
+    return static_cast<double>(clock() - start) * 1000000 / CLOCKS_PER_SEC / iterations;
+}
+
+static void measure(const string &name, const Codec *codec, size_t threshold, const string &content) {
+    // Enough rounds to amount to about 256MB of content, so short payloads are timed reliably
+    size_t iterations = std::max<size_t>(1, 256 * 1024 * 1024 / std::max<size_t>(content.length(), 1));
+
+    string stored;
+    clock_t start = clock();
+    for (size_t i = 0; i < iterations; i++) {
+        stored = Codec::encode(codec, threshold, content);
+    }
+    double encodeMicros = cpuMicros(start, iterations);
+
+    size_t decoded = 0;
+    start = clock();
+    for (size_t i = 0; i < iterations; i++) {
+        decoded += Codec::decode(stored.data(), stored.length(), content.length()).length();
+    }
+    double decodeMicros = cpuMicros(start, iterations);
+    if (decoded != iterations * content.length()) {
+        cerr << name << ": decoded contents do not match" << endl;
+        exit(1);
+    }
+
+    cout << name << ": " << stored.length() << " bytes stored, "
+         << static_cast<double>(stored.length()) * 100 / content.length() << "% of the content, encode "
+         << encodeMicros << " us (" << content.length() / std::max(encodeMicros, 0.001) << " MB/s), decode "
+         << decodeMicros << " us (" << content.length() / std::max(decodeMicros, 0.001) << " MB/s)" << endl;
+}
+
+int main(int argc, char** argv) {
+    string inputFile;
+    size_t size = 64 * 1024;
+
+    struct option longopts[] = {
+        { "help", no_argument, NULL, 'h'},
+        { "input", required_argument, NULL, 'i'},
+        { "size", required_argument, NULL, 's'},
+        { 0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "hi:s:", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
+                        "--help              -h          print this usage\n"
+                        "--input             -i          file holding the payload (default=a generated JSON config)\n"
+                        "--size              -s          bytes of the generated payload (default=65536)\n";
+                exit(0);
+                break;
+            case 'i':
+                inputFile = optarg;
+                break;
+            case 's':
+                size = atoi(optarg);
+                break;
+        }
+    }
+
+    string content;
+    if (inputFile.empty()) {
+        content = generateConfig(size);
+    } else {
+        ifstream input(inputFile.c_str(), ios::binary);
+        if (!input) {
+            cerr << "Could not open " << inputFile << endl;
+            return 1;
+        }
+        ostringstream buffer;
+        buffer << input.rdbuf();
+        content = buffer.str();
+    }
+    if (content.empty()) {
+        cerr << "The payload is empty" << endl;
+        return 1;
+    }
+    cout << "Payload: " << content.length() << " bytes" << endl;
+
+    measure(Codec::typeToString(Codec::NONE), NULL, 0, content);
+    for (int type = Codec::LZ4; type <= Codec::ZSTD; type++) {
+        string name = Codec::typeToString(static_cast<Codec::Type>(type));
+        boost::scoped_ptr<Codec> codec(Codec::create(static_cast<Codec::Type>(type)));
+        if (!codec) {
+            cout << name << ": not compiled in" << endl;
+            continue;
+        }
+        measure(name, codec.get(), 0, content);
+    }
+    return 0;
+}
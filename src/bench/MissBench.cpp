@@ -0,0 +1,198 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   MissBench.cpp
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 11:45 AM
+ */
+
+/*
+ * Throughput of lookups that miss, returned as a ZooStatus against thrown as a ZooFileException.
+ *
+ * Each of --threads threads looks up --ops paths that do not exist and maps the outcome to an errno the
+ * way the fuse callbacks do. With --baseline the miss is thrown with its message built from the path, as
+ * ZooFile reported it before. Without --zooHosts the zoo is left out and every lookup misses at once,
+ * which isolates the reporting; with it every lookup is a zoo_exists on a missing node.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../ZooFile.h"
+#include "../ZooStatus.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+static zhandle_t *handle = NULL;
+
+static int exists(const string &path, Stat &stat) {
+    if (handle == NULL) {
+        return ZNONODE;
+    }
+    return zoo_exists(handle, path.c_str(), 0, &stat);
+}
+
+static ZooResult<Stat> getStat(const string &path) {
+    Stat stat;
+    int rc = exists(path, stat);
+    if (rc != ZOK) {
+        return ZooStatus(rc, "getting the stat of");
+    }
+    return stat;
+}
+
+static Stat getStatOrThrow(const string &path) {
+    Stat stat;
+    int rc = exists(path, stat);
+    if (rc != ZOK) {
+        throw ZooFileException("An error occurred getting the stat of file: " + path, rc);
+    }
+    return stat;
+}
+
+static int lookup(const string &path, bool baseline) {
+    if (!baseline) {
+        ZooResult<Stat> result = getStat(path);
+        return result.ok() ? 0 : -result.getErrno();
+    }
+    try {
+        getStatOrThrow(path);
+        return 0;
+    } catch (const ZooFileException &e) {
+        return -zooErrno(e.getErrorCode());
+    }
+}
+
+class Worker {
+public:
+    Worker(const vector<string> &paths, size_t ops, bool baseline) :
+    paths_(paths), ops_(ops), baseline_(baseline), misses_(0) {
+
+    }
+
+    void operator()() {
+        for (size_t i = 0; i < ops_; i++) {
+            if (lookup(paths_[i % paths_.size()], baseline_) == -ENOENT) {
+                misses_++;
+            }
+        }
+    }
+
+    size_t getMisses() const {
+        return misses_;
+    }
+
+private:
+    const vector<string> &paths_;
+    size_t ops_;
+    bool baseline_;
+    size_t misses_;
+};
+
+int main(int argc, char** argv) {
+    size_t threads = 4;
+    size_t ops = 1000000;
+    bool baseline = false;
+    string zooHosts;
+
+    struct option longopts[] = {
+        { "help", no_argument, NULL, 'h'},
+        { "threads", required_argument, NULL, 't'},
+        { "ops", required_argument, NULL, 'o'},
+        { "baseline", no_argument, NULL, 'B'},
+        { "zooHosts", required_argument, NULL, 'z'},
+        { 0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "ht:o:Bz:", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
+                        "--help              -h          print this usage\n"
+                        "--threads           -t          number of threads looking up (default=4)\n"
+                        "--ops               -o          lookups per thread (default=1000000)\n"
+                        "--baseline          -B          throw and catch a ZooFileException for every miss instead\n"
+                        "--zooHosts          -z          zookeeper hosts to look the paths up in (default=none)\n";
+                exit(0);
+                break;
+            case 't':
+                threads = atoi(optarg);
+                break;
+            case 'o':
+                ops = atoi(optarg);
+                break;
+            case 'B':
+                baseline = true;
+                break;
+            case 'z':
+                zooHosts = optarg;
+                break;
+        }
+    }
+    if (threads == 0 || ops == 0) {
+        cerr << "--threads and --ops must be positive" << endl;
+        return 1;
+    }
+
+    if (!zooHosts.empty()) {
+        handle = zookeeper_init(zooHosts.c_str(), NULL, 10000, NULL, NULL, 0);
+        for (int i = 0; handle != NULL && zoo_state(handle) != ZOO_CONNECTED_STATE && i < 100; i++) {
+            usleep(100000);
+        }
+        if (handle == NULL || zoo_state(handle) != ZOO_CONNECTED_STATE) {
+            cerr << "Could not connect to " << zooHosts << endl;
+            return 1;
+        }
+    }
+
+    vector<string> paths;
+    for (size_t i = 0; i < 1024; i++) {
+        ostringstream path;
+        path << "/zookeeperfuse-miss-bench/missing" << i;
+        paths.push_back(path.str());
+    }
+
+    vector<Worker> workers(threads, Worker(paths, ops, baseline));
+    boost::thread_group group;
+    ptime start = microsec_clock::universal_time();
+    for (size_t i = 0; i < threads; i++) {
+        group.create_thread(boost::ref(workers[i]));
+    }
+    group.join_all();
+    double seconds = static_cast<double>((microsec_clock::universal_time() - start).total_microseconds()) / 1000000;
+
+    size_t misses = 0;
+    for (size_t i = 0; i < threads; i++) {
+        misses += workers[i].getMisses();
+    }
+    cout << (baseline ? "ZooFileException" : "ZooStatus") << ": " << threads << " threads, " << misses
+         << " misses of " << threads * ops << " lookups, " << threads * ops / seconds << " lookups/s" << endl;
+
+    if (handle != NULL) {
+        zookeeper_close(handle);
+    }
+    return 0;
+}
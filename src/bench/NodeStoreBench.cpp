@@ -0,0 +1,176 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   NodeStoreBench.cpp
+ * Author: kyle
+ *
+ * Created on October 25, 2026, 10:05 AM
+ */
+
+/*
+ * Memory per node of NodeStore against a map of path and payload strings.
+ *
+ * Builds a tree of --nodes nodes, 100 to a directory three levels deep, with --payload bytes each, then
+ * reports the growth of the resident set and NodeStore's own estimate divided by the node count, and the
+ * cost of a lookup. Run once with --baseline for the map, in a separate process so the two do not share heap.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/unordered_map.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "../NodeStore.h"
+
+using namespace std;
+using namespace boost::posix_time;
+
+static size_t residentBytes() {
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL) {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    if (fscanf(statm, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(statm);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static string nodePath(size_t i) {
+    ostringstream path;
+    path << "/bench/service" << i / 10000 << "/group" << (i / 100) % 100 << "/node" << i % 100;
+    return path.str();
+}
+
+static string nodeContent(size_t i, size_t length) {
+    string retval(length, 'x');
+    for (size_t j = 0; j < length && j < sizeof(size_t); j++) {
+        retval[j] = 'a' + (i >> (j * 4)) % 16;
+    }
+    return retval;
+}
+
+static double elapsedNanos(const ptime &start, size_t count) {
+    return static_cast<double>((microsec_clock::universal_time() - start).total_microseconds()) * 1000 / count;
+}
+
+int main(int argc, char** argv) {
+    size_t nodes = 1000000;
+    size_t payload = 12;
+    size_t budget = 0;
+    bool baseline = false;
+
+    struct option longopts[] = {
+        { "help", no_argument, NULL, 'h'},
+        { "nodes", required_argument, NULL, 'n'},
+        { "payload", required_argument, NULL, 'p'},
+        { "budget", required_argument, NULL, 'b'},
+        { "baseline", no_argument, NULL, 'B'},
+        { 0, 0, 0, 0}
+    };
+    int c;
+    while ((c = getopt_long(argc, argv, "hn:p:b:B", longopts, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                cerr << "Usage: "<< argv[0] << " [OPTIONS]\n"
+                        "--help              -h          print this usage\n"
+                        "--nodes             -n          number of nodes stored (default=1000000)\n"
+                        "--payload           -p          bytes of content per node (default=12)\n"
+                        "--budget            -b          byte budget of the store (default=enough to evict nothing)\n"
+                        "--baseline          -B          store path and content strings in a hash map instead\n";
+                exit(0);
+                break;
+            case 'n':
+                nodes = atoi(optarg);
+                break;
+            case 'p':
+                payload = atoi(optarg);
+                break;
+            case 'b':
+                budget = atol(optarg);
+                break;
+            case 'B':
+                baseline = true;
+                break;
+        }
+    }
+    if (nodes == 0) {
+        cerr << "--nodes must be positive" << endl;
+        return 1;
+    }
+    if (budget == 0) {
+        // The store keeps about one node per 64 bytes of budget, leave room for the payloads on top
+        budget = nodes * (128 + payload);
+    }
+
+    // Generating the paths allocates too, keep it out of the measurement
+    vector<string> paths(nodes);
+    for (size_t i = 0; i < nodes; i++) {
+        paths[i] = nodePath(i);
+    }
+    string probe;
+
+    size_t before = residentBytes();
+    ptime start = microsec_clock::universal_time();
+    boost::unordered_map<string, string> map;
+    NodeStore* store = baseline ? NULL : new NodeStore(budget);
+    for (size_t i = 0; i < nodes; i++) {
+        if (store != NULL) {
+            store->put(paths[i], nodeContent(i, payload), false);
+        } else {
+            map[paths[i]] = nodeContent(i, payload);
+        }
+    }
+    double insertNanos = elapsedNanos(start, nodes);
+    size_t after = residentBytes();
+
+    start = microsec_clock::universal_time();
+    size_t found = 0;
+    for (size_t i = 0; i < nodes; i++) {
+        size_t j = (i * 7919) % nodes;
+        if (store != NULL) {
+            found += store->get(paths[j], probe) ? 1 : 0;
+        } else {
+            boost::unordered_map<string, string>::const_iterator it = map.find(paths[j]);
+            if (it != map.end()) {
+                probe = it->second;
+                found++;
+            }
+        }
+    }
+    double lookupNanos = elapsedNanos(start, nodes);
+
+    cout << (baseline ? "unordered_map<string, string>" : "NodeStore") << ": " << nodes << " nodes of "
+         << payload << " bytes" << endl;
+    cout << "  resident growth: " << (after - before) / nodes << " bytes/node" << endl;
+    if (store != NULL) {
+        cout << "  store estimate:  " << store->getMemoryUsage() / nodes << " bytes/node, "
+             << store->getNodeCount() << " nodes kept" << endl;
+    }
+    cout << "  insert: " << insertNanos << " ns/node, lookup: " << lookupNanos << " ns/node, " << found
+         << " found" << endl;
+    delete store;
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Codec.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "Codec.h"
+#include "Lz4Codec.h"
+#include "ZstdCodec.h"
+
+const size_t Codec::HEADER_SIZE = 8;
+
+static const char MAGIC[] = { 'Z', 'F', 'C' };
+// Shared with the manifests of chunked files, see ChunkManifest
+static const char PREFIX[] = { 'Z', 'F' };
+
+Codec::~Codec() {
+
+}
+
+Codec* Codec::create(Type type) {
+    switch (type) {
+#ifdef HAVE_LZ4
+        case LZ4:
+            return new Lz4Codec();
+#endif
+#ifdef HAVE_ZSTD
+        case ZSTD:
+            return new ZstdCodec();
+#endif
+        default:
+            return NULL;
+    }
+}
+
+Codec::Type Codec::stringToType(const string &type) {
+    for (int i = NONE; i <= ZSTD; i++) {
+        Type retval = static_cast<Type> (i);
+        if (typeToString(retval) == type) {
+            return retval;
+        }
+    }
+    return NONE;
+}
+
+string Codec::typeToString(Type type) {
+    string retval;
+    switch (type) {
+        case NONE:
+            retval = "NONE";
+            break;
+        case LZ4:
+            retval = "LZ4";
+            break;
+        case ZSTD:
+            retval = "ZSTD";
+            break;
+        case STORED:
+            retval = "STORED";
+            break;
+        default:
+            retval = "INVALID";
+    }
+    return retval;
+}
+
+static string frame(Codec::Type type, size_t length, const string &payload) {
+    uint32_t rawLength = length;
+    string retval;
+    retval.reserve(Codec::HEADER_SIZE + payload.length());
+    retval.append(MAGIC, sizeof(MAGIC));
+    retval.push_back(static_cast<char>(type));
+    retval.push_back(static_cast<char>((rawLength >> 24) & 0xFF));
+    retval.push_back(static_cast<char>((rawLength >> 16) & 0xFF));
+    retval.push_back(static_cast<char>((rawLength >> 8) & 0xFF));
+    retval.push_back(static_cast<char>(rawLength & 0xFF));
+    retval.append(payload);
+    return retval;
+}
+
+string Codec::encode(const Codec *codec, size_t threshold, const string &content) {
+    if (content.length() > 0xFFFFFFFFu) {
+        return content;
+    }
+    // Reads decode whether compression is on or not, so contents which look like a frame, or like a manifest,
+    // are always framed
+    bool magic = content.length() >= sizeof(PREFIX) && memcmp(content.data(), PREFIX, sizeof(PREFIX)) == 0;
+
+    string compressed;
+    if (codec == NULL || content.length() < threshold || !codec->compress(content.data(), content.length(), compressed) ||
+        compressed.length() + HEADER_SIZE >= content.length()) {
+        return magic ? frame(STORED, content.length(), content) : content;
+    }
+    return frame(codec->getType(), content.length(), compressed);
+}
+
+bool Codec::isEncoded(const char *data, size_t length) {
+    if (length < HEADER_SIZE || memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+    unsigned char type = data[sizeof(MAGIC)];
+    return type == LZ4 || type == ZSTD || type == STORED;
+}
+
+static uint32_t headerLength(const char *data) {
+    const unsigned char *header = reinterpret_cast<const unsigned char*>(data);
+    return (static_cast<uint32_t>(header[4]) << 24) | (static_cast<uint32_t>(header[5]) << 16) |
+           (static_cast<uint32_t>(header[6]) << 8) | static_cast<uint32_t>(header[7]);
+}
+
+size_t Codec::decodedLength(const char *data, size_t length) {
+    if (!isEncoded(data, length)) {
+        return length;
+    }
+    return headerLength(data);
+}
+
+string Codec::decode(const char *data, size_t length, size_t maxLength) {
+    if (!isEncoded(data, length)) {
+        return string(data, length);
+    }
+
+    Type type = static_cast<Type>(static_cast<unsigned char>(data[3]));
+    uint32_t rawLength = headerLength(data);
+    if (rawLength > maxLength) {
+        throw CodecException("Payload claims a length beyond the limit: " + typeToString(type));
+    }
+    if (type == STORED) {
+        if (rawLength != length - HEADER_SIZE) {
+            throw CodecException("Stored payload does not match its length");
+        }
+        return string(data + HEADER_SIZE, rawLength);
+    }
+
+    boost::scoped_ptr<Codec> codec(create(type));
+    if (!codec) {
+        throw CodecException("Payload is compressed with unsupported codec: " + typeToString(type));
+    }
+
+    string retval(rawLength, '\0');
+    if (rawLength > 0 && !codec->decompress(data + HEADER_SIZE, length - HEADER_SIZE, &retval[0], rawLength)) {
+        throw CodecException("Failed to decompress payload with codec: " + typeToString(type));
+    }
+    return retval;
+}
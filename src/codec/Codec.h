@@ -0,0 +1,97 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Codec.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:12 AM
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <string>
+#include <exception>
+
+using namespace std;
+
+class CodecException : public std::exception {
+public:
+    CodecException(string msg) :
+    msg_(msg) {
+
+    }
+
+    virtual ~CodecException() throw() {
+
+    }
+
+    virtual const char* what() const throw()
+    {
+      return msg_.c_str();
+    }
+
+private:
+    string msg_;
+};
+
+/*
+ * Payload compression for node contents.
+ *
+ * Compressed payloads are framed with an 8 byte header: the magic "ZFC", one byte identifying the codec
+ * and the uncompressed length as a 32 bit big-endian integer. Anything without the header is treated as
+ * a raw legacy payload, so compression can be switched on for a mount without rewriting existing nodes.
+ * Raw content which itself starts with "ZF", the prefix of both frames and chunk manifests, is framed as
+ * STORED with or without a codec, so it is not mistaken for either.
+ */
+class Codec {
+public:
+    enum Type {
+        NONE = 0,
+        LZ4 = 1,
+        ZSTD = 2,
+        // Framed without compression, not selectable as a codec
+        STORED = 3
+    };
+
+    static const size_t HEADER_SIZE;
+
+    virtual ~Codec();
+
+    virtual Type getType() const = 0;
+
+    // Returns false if the codec could not produce output for the given input
+    virtual bool compress(const char *in, size_t length, string &out) const = 0;
+    virtual bool decompress(const char *in, size_t length, char *out, size_t rawLength) const = 0;
+
+    // Returns NULL if support for the codec was not compiled in
+    static Codec* create(Type type);
+
+    static Type stringToType(const string &type);
+    static string typeToString(Type type);
+
+    // Frames the content with the codec, if any, when it is at least threshold bytes and compression actually
+    // helps. Content left uncompressed is framed as STORED if it would otherwise read as a frame
+    // or a chunk manifest
+    static string encode(const Codec *codec, size_t threshold, const string &content);
+
+    static bool isEncoded(const char *data, size_t length);
+    // Size of the content decode would return, without decompressing it
+    static size_t decodedLength(const char *data, size_t length);
+    // Payloads claiming to decode to more than maxLength bytes are refused before anything is allocated
+    static string decode(const char *data, size_t length, size_t maxLength);
+};
+
+#endif /* CODEC_H */
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Lz4Codec.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:40 AM
+ */
+
+#ifdef HAVE_LZ4
+
+#include <limits.h>
+#include <lz4.h>
+
+#include "Lz4Codec.h"
+
+Codec::Type Lz4Codec::getType() const {
+    return LZ4;
+}
+
+bool Lz4Codec::compress(const char *in, size_t length, string &out) const {
+    if (length > INT_MAX) {
+        return false;
+    }
+    int bound = LZ4_compressBound(length);
+    if (bound <= 0) {
+        return false;
+    }
+    out.resize(bound);
+    int written = LZ4_compress_default(in, &out[0], length, bound);
+    if (written <= 0) {
+        return false;
+    }
+    out.resize(written);
+    return true;
+}
+
+bool Lz4Codec::decompress(const char *in, size_t length, char *out, size_t rawLength) const {
+    if (length > INT_MAX || rawLength > INT_MAX) {
+        return false;
+    }
+    int read = LZ4_decompress_safe(in, out, length, rawLength);
+    return read >= 0 && static_cast<size_t>(read) == rawLength;
+}
+#endif
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   Lz4Codec.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:40 AM
+ */
+
+#ifdef HAVE_LZ4
+
+#ifndef LZ4CODEC_H
+#define LZ4CODEC_H
+
+#include "Codec.h"
+
+class Lz4Codec : public Codec {
+public:
+    virtual Type getType() const;
+
+    virtual bool compress(const char *in, size_t length, string &out) const;
+    virtual bool decompress(const char *in, size_t length, char *out, size_t rawLength) const;
+};
+
+#endif
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZstdCodec.cpp
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:52 AM
+ */
+
+#ifdef HAVE_ZSTD
+
+#include <zstd.h>
+
+#include "ZstdCodec.h"
+
+const int ZstdCodec::DEFAULT_LEVEL = 3;
+
+ZstdCodec::ZstdCodec(int level) :
+level_(level) {
+
+}
+
+Codec::Type ZstdCodec::getType() const {
+    return ZSTD;
+}
+
+bool ZstdCodec::compress(const char *in, size_t length, string &out) const {
+    out.resize(ZSTD_compressBound(length));
+    size_t written = ZSTD_compress(&out[0], out.length(), in, length, level_);
+    if (ZSTD_isError(written)) {
+        return false;
+    }
+    out.resize(written);
+    return true;
+}
+
+bool ZstdCodec::decompress(const char *in, size_t length, char *out, size_t rawLength) const {
+    size_t read = ZSTD_decompress(out, rawLength, in, length);
+    return !ZSTD_isError(read) && read == rawLength;
+}
+#endif
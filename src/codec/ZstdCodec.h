@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016 Kyle Borowski
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File:   ZstdCodec.h
+ * Author: kyle
+ *
+ * Created on October 18, 2026, 9:52 AM
+ */
+
+#ifdef HAVE_ZSTD
+
+#ifndef ZSTDCODEC_H
+#define ZSTDCODEC_H
+
+#include "Codec.h"
+
+class ZstdCodec : public Codec {
+public:
+    static const int DEFAULT_LEVEL;
+
+    ZstdCodec(int level = DEFAULT_LEVEL);
+
+    virtual Type getType() const;
+
+    virtual bool compress(const char *in, size_t length, string &out) const;
+    virtual bool decompress(const char *in, size_t length, char *out, size_t rawLength) const;
+
+private:
+    int level_;
+};
+
+#endif
+#endif
@@ -46,11 +46,13 @@ Log4CPPLogger::Log4CPPLogger(Logger::LogLevel& maxLevel) : Logger(maxLevel) {
     }
     rootLog.setPriority(logPriority);
 
-    log4cpp::Appender *appender = new log4cpp::OstreamAppender("console", &std::cout);
-    appender->setLayout(new log4cpp::BasicLayout());
-
+    // Every mount of a daemon has a logger, they all write through the first one's appender
     zkLogger_ = &log4cpp::Category::getInstance(std::string("zkLogger"));
-    zkLogger_->addAppender(appender);
+    if (zkLogger_->getAppender() == NULL) {
+        log4cpp::Appender *appender = new log4cpp::OstreamAppender("console", &std::cout);
+        appender->setLayout(new log4cpp::BasicLayout());
+        zkLogger_->addAppender(appender);
+    }
 
     this->log(Logger::DEBUG, "Using LOG4CPP");
 }
@@ -60,6 +62,10 @@ Log4CPPLogger::~Log4CPPLogger() {
 }
 
 void Log4CPPLogger::log(LogLevel level, const char *fmt, ...) {
+    // Callbacks log at DEBUG on every request, don't format what log4cpp would drop
+    if (level > getLogLevel()) {
+        return;
+    }
     char buffer[512];
     
     va_list args;